@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2026 agent <agent@local>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+#
+# Compiles the .device files into the index read by libratbag-data.c, see
+# the layout described there. All integers are little endian so the index
+# can be cross-built.
+#
+
+import argparse
+import configparser
+import os
+import struct
+import sys
+
+MAGIC = b'RBDI'
+VERSION = 1
+
+BUSTYPES = {
+    'usb': 0x03,
+    'bluetooth': 0x05,
+}
+
+
+def parse_data_file(path):
+    data = configparser.ConfigParser(strict=True)
+    # Don't convert to lowercase
+    data.optionxform = lambda option: option
+    data.read(path)
+
+    matches = data['Device']['DeviceMatch']
+    return matches.split(';')
+
+
+def parse_match(match):
+    bus, vid, pid = match.split(':')
+    return BUSTYPES[bus], int(vid, 16), int(pid, 16)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Device index compiler')
+    parser.add_argument('--output', required=True)
+    parser.add_argument('file', nargs='+')
+    args = parser.parse_args()
+
+    files = sorted(args.file, key=lambda p: os.path.basename(p).encode('utf-8'))
+    entries = []
+    for idx, path in enumerate(files):
+        for m in parse_data_file(path):
+            if not m:
+                continue
+            try:
+                entries.append(parse_match(m) + (idx,))
+            except (KeyError, ValueError):
+                print('Invalid DeviceMatch={} in {}'.format(m, path))
+                sys.exit(1)
+    entries.sort()
+
+    names = [os.path.basename(p).encode('utf-8') + b'\0' for p in files]
+    offsets = []
+    offset = 16 + 8 * len(entries) + 4 * len(names)
+    for n in names:
+        offsets.append(offset)
+        offset += len(n)
+
+    with open(args.output, 'wb') as f:
+        f.write(struct.pack('<4sIII', MAGIC, VERSION, len(entries), len(names)))
+        for e in entries:
+            f.write(struct.pack('<HHHH', *e))
+        for o in offsets:
+            f.write(struct.pack('<I', o))
+        for n in names:
+            f.write(n)
@@ -87,11 +87,11 @@ static int ratbagd_button_set_button(sd_bus *bus,
 	r = ratbag_button_set_button(button->lib_button, map);
 
 	if (r == 0) {
-		sd_bus_emit_properties_changed(bus,
-					       button->path,
-					       RATBAGD_NAME_ROOT ".Button",
-					       "Mapping",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(button->device),
+					   button->path,
+					   RATBAGD_NAME_ROOT ".Button",
+					   "Mapping",
+					   NULL);
 	}
 
 	return 0;
@@ -139,11 +139,11 @@ static int ratbagd_button_set_special(sd_bus *bus,
 	r = ratbag_button_set_special(button->lib_button, special);
 
 	if (r == 0) {
-		sd_bus_emit_properties_changed(bus,
-					       button->path,
-					       RATBAGD_NAME_ROOT ".Button",
-					       "Mapping",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(button->device),
+					   button->path,
+					   RATBAGD_NAME_ROOT ".Button",
+					   "Mapping",
+					   NULL);
 	}
 
 	return 0;
@@ -247,11 +247,11 @@ static int ratbagd_button_set_macro(sd_bus *bus,
 	}
 
 	if (r == 0) {
-		sd_bus_emit_properties_changed(bus,
-					       button->path,
-					       RATBAGD_NAME_ROOT ".Button",
-					       "Mapping",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(button->device),
+					   button->path,
+					   RATBAGD_NAME_ROOT ".Button",
+					   "Mapping",
+					   NULL);
 	}
 
 	return 0;
@@ -268,6 +268,8 @@ static int ratbagd_button_get_mapping(sd_bus *bus,
 	struct ratbagd_button *button = userdata;
 	enum ratbag_button_action_type type;
 
+	verify_device_idle(button->device, error);
+
 	type = ratbag_button_get_action_type(button->lib_button);
 	if (type == RATBAG_BUTTON_ACTION_TYPE_KEY)
 		type = RATBAG_BUTTON_ACTION_TYPE_UNKNOWN;
@@ -300,8 +302,11 @@ static int ratbagd_button_set_mapping(sd_bus *bus,
 				      void *userdata,
 				      sd_bus_error *error)
 {
+	struct ratbagd_button *button = userdata;
 	enum ratbag_button_action_type type;
 
+	verify_device_idle(button->device, error);
+
 	CHECK_CALL(sd_bus_message_enter_container(m, SD_BUS_TYPE_STRUCT, "uv"));
 	CHECK_CALL(sd_bus_message_read(m, "u", &type));
 
@@ -368,6 +373,8 @@ static int ratbagd_button_disable(sd_bus_message *m,
 	struct ratbagd_button *button = userdata;
 	int r;
 
+	verify_device_idle(button->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, ""));
 
 	r = ratbag_button_disable(button->lib_button);
@@ -449,12 +456,11 @@ struct ratbagd_button *ratbagd_button_free(struct ratbagd_button *button)
 int ratbagd_button_resync(sd_bus *bus,
 			      struct ratbagd_button *button)
 {
-	return sd_bus_emit_properties_changed(bus,
-					      button->path,
-					      RATBAGD_NAME_ROOT ".Button",
-					      "ButtonMapping",
-					      "SpecialMapping",
-					      "Macro",
-					      "ActionType",
-					      NULL);
+	ratbagd_properties_changed(ratbagd_device_get_ctx(button->device),
+				   button->path,
+				   RATBAGD_NAME_ROOT ".Button",
+				   "Mapping",
+				   NULL);
+
+	return 0;
 }
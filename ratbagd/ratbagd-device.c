@@ -29,11 +29,14 @@
 #include <errno.h>
 #include <limits.h>
 #include <libratbag.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
 #include <systemd/sd-bus.h>
 #include <systemd/sd-event.h>
+#include <unistd.h>
 #include "ratbagd.h"
 #include "shared-macro.h"
 #include "shared-rbtree.h"
@@ -53,8 +56,19 @@ struct ratbagd_device {
 	sd_bus_slot *profile_enum_slot;
 	unsigned int n_profiles;
 	struct ratbagd_profile **profiles;
+
+	/* set while a commit runs on the worker thread */
+	pthread_t commit_thread;
+	int commit_fd;
+	int commit_result;
+	uint64_t commit_start;
+	sd_event_source *commit_source;
+	sd_event_source *commit_progress_source;
 };
 
+/* interval between CommitProgress signals */
+#define RATBAGD_COMMIT_PROGRESS_USEC (250 * 1000)
+
 #define ratbagd_device_from_node(_ptr) \
 		rbnode_of((_ptr), struct ratbagd_device, node)
 
@@ -166,17 +180,145 @@ static int ratbagd_device_get_profiles(sd_bus *bus,
 	return 0;
 }
 
-static void ratbagd_device_commit_pending(void *data)
+static void *ratbagd_device_commit_thread(void *data)
 {
 	struct ratbagd_device *device = data;
+	uint64_t one = 1;
+
+	/* Nothing else touches lib_device while commit_source is set, the
+	 * setters bail out with EBUSY. */
+	device->commit_result = ratbag_device_commit(device->lib_device);
+
+	if (write(device->commit_fd, &one, sizeof(one)) != sizeof(one))
+		log_error("%s: failed to signal commit completion: %m\n",
+			  device->sysname);
+
+	return NULL;
+}
+
+static int ratbagd_device_emit_commit_progress(struct ratbagd_device *device,
+					       uint64_t now)
+{
+	uint32_t elapsed = (now - device->commit_start) / 1000;
+
+	return sd_bus_emit_signal(device->ctx->bus,
+				  device->path,
+				  RATBAGD_NAME_ROOT ".Device",
+				  "CommitProgress",
+				  "u",
+				  elapsed);
+}
+
+static int ratbagd_device_commit_progress(sd_event_source *source,
+					  uint64_t usec,
+					  void *userdata)
+{
+	struct ratbagd_device *device = userdata;
+
+	(void) ratbagd_device_emit_commit_progress(device, usec);
+
+	CHECK_CALL(sd_event_source_set_time(source,
+					    usec + RATBAGD_COMMIT_PROGRESS_USEC));
+	CHECK_CALL(sd_event_source_set_enabled(source, SD_EVENT_ONESHOT));
+
+	return 0;
+}
+
+static int ratbagd_device_commit_done(sd_event_source *source,
+				      int fd,
+				      uint32_t revents,
+				      void *userdata)
+{
+	struct ratbagd_device *device = userdata;
 	int r;
 
-	r = ratbag_device_commit(device->lib_device);
+	pthread_join(device->commit_thread, NULL);
+
+	device->commit_progress_source = sd_event_source_unref(device->commit_progress_source);
+	device->commit_source = sd_event_source_unref(device->commit_source);
+	device->commit_fd = safe_close(device->commit_fd);
+
+	r = device->commit_result;
 	if (r)
 		log_error("error committing device (%d)\n", r);
 	if (r < 0)
 		ratbagd_device_resync(device, device->ctx->bus);
+
+	(void) sd_bus_emit_signal(device->ctx->bus,
+				  device->path,
+				  RATBAGD_NAME_ROOT ".Device",
+				  "CommitFinished",
+				  "i",
+				  r);
+
 	ratbagd_device_unref(device);
+
+	return 0;
+}
+
+static int ratbagd_device_commit_start(struct ratbagd_device *device)
+{
+	sd_event *event = device->ctx->event;
+	int r;
+
+	device->commit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (device->commit_fd < 0)
+		return -errno;
+
+	r = sd_event_add_io(event,
+			    &device->commit_source,
+			    device->commit_fd,
+			    EPOLLIN,
+			    ratbagd_device_commit_done,
+			    device);
+	if (r < 0)
+		goto error;
+
+	sd_event_now(event, CLOCK_MONOTONIC, &device->commit_start);
+	r = sd_event_add_time(event,
+			      &device->commit_progress_source,
+			      CLOCK_MONOTONIC,
+			      device->commit_start + RATBAGD_COMMIT_PROGRESS_USEC,
+			      0,
+			      ratbagd_device_commit_progress,
+			      device);
+	if (r < 0)
+		goto error;
+
+	/* the worker's ref is dropped in ratbagd_device_commit_done() */
+	ratbagd_device_ref(device);
+	r = -pthread_create(&device->commit_thread,
+			    NULL,
+			    ratbagd_device_commit_thread,
+			    device);
+	if (r < 0) {
+		ratbagd_device_unref(device);
+		goto error;
+	}
+
+	(void) ratbagd_device_emit_commit_progress(device, device->commit_start);
+
+	return 0;
+
+error:
+	device->commit_progress_source = sd_event_source_unref(device->commit_progress_source);
+	device->commit_source = sd_event_source_unref(device->commit_source);
+	device->commit_fd = safe_close(device->commit_fd);
+	return r;
+}
+
+void ratbagd_device_commit_wait(struct ratbagd_device *device)
+{
+	assert(device);
+
+	if (!ratbagd_device_committing(device))
+		return;
+
+	/* blocks in pthread_join() until the worker is done */
+	ratbagd_device_commit_done(device->commit_source,
+				   device->commit_fd,
+				   EPOLLIN,
+				   device);
 }
 
 static int ratbagd_device_commit(sd_bus_message *m,
@@ -184,10 +326,123 @@ static int ratbagd_device_commit(sd_bus_message *m,
 				 sd_bus_error *error)
 {
 	struct ratbagd_device *device = userdata;
+	int r;
 
-	ratbagd_schedule_task(device->ctx,
-			      ratbagd_device_commit_pending,
-			      ratbagd_device_ref(device));
+	/* No changes can be made while a commit is in flight, so that
+	 * commit already covers this request */
+	if (!ratbagd_device_committing(device)) {
+		/* Emit what is queued now, the getters refuse to run
+		 * until the commit is done */
+		ratbagd_properties_changed_flush(device->ctx);
+		r = ratbagd_device_commit_start(device);
+		if (r < 0) {
+			errno = -r;
+			log_error("%s: failed to start commit: %m\n",
+				  device->sysname);
+			return r;
+		}
+	}
+
+	CHECK_CALL(sd_bus_reply_method_return(m, "u", 0));
+
+	return 0;
+}
+
+static int ratbagd_device_get_snapshot(sd_bus_message *m,
+				       void *userdata,
+				       sd_bus_error *error)
+{
+	_cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+	struct ratbagd_device *device = userdata;
+	unsigned int i;
+
+	/* the worker thread owns the libratbag device */
+	verify_device_idle(device, error);
+
+	CHECK_CALL(sd_bus_message_new_method_return(m, &reply));
+	CHECK_CALL(sd_bus_message_open_container(reply, 'a', "{sv}"));
+	CHECK_CALL(ratbagd_snapshot_append(reply,
+					   ratbagd_device_vtable,
+					   device->path,
+					   RATBAGD_NAME_ROOT ".Device",
+					   device,
+					   error));
+
+	CHECK_CALL(sd_bus_message_open_container(reply, 'e', "sv"));
+	CHECK_CALL(sd_bus_message_append(reply, "s", "Profiles"));
+	CHECK_CALL(sd_bus_message_open_container(reply, 'v', "aa{sv}"));
+	CHECK_CALL(sd_bus_message_open_container(reply, 'a', "a{sv}"));
+	for (i = 0; i < device->n_profiles; i++) {
+		if (!device->profiles[i])
+			continue;
+
+		CHECK_CALL(ratbagd_profile_snapshot(reply,
+						    device->profiles[i],
+						    error));
+	}
+	CHECK_CALL(sd_bus_message_close_container(reply));
+	CHECK_CALL(sd_bus_message_close_container(reply));
+	CHECK_CALL(sd_bus_message_close_container(reply));
+
+	CHECK_CALL(sd_bus_message_close_container(reply));
+
+	return sd_bus_send(NULL, reply, NULL);
+}
+
+static int ratbagd_device_apply_profile(sd_bus_message *m,
+					const char *path,
+					void *userdata,
+					sd_bus_error *error)
+{
+	struct ratbagd_device *device = userdata;
+	unsigned int i;
+
+	for (i = 0; i < device->n_profiles; i++) {
+		struct ratbagd_profile *profile = device->profiles[i];
+
+		if (!profile || !streq(ratbagd_profile_get_path(profile), path))
+			continue;
+
+		CHECK_CALL(ratbagd_profile_apply_snapshot(m, profile, error));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int ratbagd_device_apply_profiles(sd_bus_message *m,
+					 const char *key,
+					 void *userdata,
+					 sd_bus_error *error)
+{
+	if (!streq(key, "Profiles"))
+		return 0;
+
+	CHECK_CALL(ratbagd_snapshot_apply_children(m,
+						   ratbagd_device_apply_profile,
+						   userdata,
+						   error));
+
+	return 1;
+}
+
+static int ratbagd_device_apply_snapshot(sd_bus_message *m,
+					 void *userdata,
+					 sd_bus_error *error)
+{
+	struct ratbagd_device *device = userdata;
+
+	verify_device_idle(device, error);
+
+	/* Like the individual setters this only changes the in-memory
+	 * state, the caller still needs to Commit() */
+	CHECK_CALL(ratbagd_snapshot_apply(m,
+					  ratbagd_device_vtable,
+					  device->path,
+					  RATBAGD_NAME_ROOT ".Device",
+					  device,
+					  ratbagd_device_apply_profiles,
+					  error));
 
 	CHECK_CALL(sd_bus_reply_method_return(m, "u", 0));
 
@@ -226,7 +481,11 @@ const sd_bus_vtable ratbagd_device_vtable[] = {
 	SD_BUS_PROPERTY("Name", "s", ratbagd_device_get_device_name, 0, SD_BUS_VTABLE_PROPERTY_CONST),
 	SD_BUS_PROPERTY("Profiles", "ao", ratbagd_device_get_profiles, 0, SD_BUS_VTABLE_PROPERTY_CONST),
 	SD_BUS_METHOD("Commit", "", "u", ratbagd_device_commit, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("GetSnapshot", "", "a{sv}", ratbagd_device_get_snapshot, SD_BUS_VTABLE_UNPRIVILEGED),
+	SD_BUS_METHOD("ApplySnapshot", "a{sv}", "u", ratbagd_device_apply_snapshot, SD_BUS_VTABLE_UNPRIVILEGED),
 	SD_BUS_SIGNAL("Resync", "", 0),
+	SD_BUS_SIGNAL("CommitProgress", "u", 0),
+	SD_BUS_SIGNAL("CommitFinished", "i", 0),
 	SD_BUS_VTABLE_END,
 };
 
@@ -247,6 +506,7 @@ int ratbagd_device_new(struct ratbagd_device **out,
 	device = zalloc(sizeof(*device));
 	device->refcount = 1;
 	device->ctx = ctx;
+	device->commit_fd = -1;
 	rbnode_init(&device->node);
 	device->lib_device = ratbag_device_ref(lib_device);
 
@@ -296,6 +556,7 @@ static void ratbagd_device_free(struct ratbagd_device *device)
 		return;
 
 	assert(!ratbagd_device_linked(device));
+	assert(!ratbagd_device_committing(device));
 
 	for (i = 0; i < device->n_profiles; ++i)
 		device->profiles[i] = ratbagd_profile_free(device->profiles[i]);
@@ -329,6 +590,12 @@ struct ratbagd_device *ratbagd_device_unref(struct ratbagd_device *device)
 	return NULL;
 }
 
+struct ratbagd *ratbagd_device_get_ctx(struct ratbagd_device *device)
+{
+	assert(device);
+	return device->ctx;
+}
+
 const char *ratbagd_device_get_sysname(struct ratbagd_device *device)
 {
 	assert(device);
@@ -368,6 +635,12 @@ int ratbagd_device_resync(struct ratbagd_device *device, sd_bus *bus)
 				  NULL);
 }
 
+bool ratbagd_device_committing(struct ratbagd_device *device)
+{
+	assert(device);
+	return device->commit_source != NULL;
+}
+
 bool ratbagd_device_linked(struct ratbagd_device *device)
 {
 	return device && rbnode_linked(&device->node);
@@ -34,6 +34,7 @@
 #include "libratbag-util.h"
 
 struct ratbagd_led {
+	struct ratbagd_device *device;
 	struct ratbag_led *lib_led;
 	unsigned int index;
 	char *path;
@@ -76,6 +77,8 @@ static int ratbagd_led_get_mode(sd_bus *bus,
 	struct ratbagd_led *led = userdata;
 	enum ratbag_led_mode mode;
 
+	verify_device_idle(led->device, error);
+
 	mode = ratbag_led_get_mode(led->lib_led);
 
 	verify_unsigned_int(mode);
@@ -97,17 +100,18 @@ static int ratbagd_led_set_mode(sd_bus *bus,
 	enum ratbag_led_mode mode;
 	int r;
 
+	verify_device_idle(led->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, "u", &mode));
 
 	r = ratbag_led_set_mode(led->lib_led, mode);
 
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       led->path,
-					       RATBAGD_NAME_ROOT ".Led",
-					       "Mode",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(led->device),
+					   led->path,
+					   RATBAGD_NAME_ROOT ".Led",
+					   "Mode",
+					   NULL);
 	}
 
 	return 0;
@@ -124,6 +128,8 @@ static int ratbagd_led_get_color(sd_bus *bus,
 	struct ratbagd_led *led = userdata;
 	struct ratbag_color c;
 
+	verify_device_idle(led->device, error);
+
 	c = ratbag_led_get_color(led->lib_led);
 	CHECK_CALL(sd_bus_message_append(reply, "(uuu)", c.red, c.green, c.blue));
 
@@ -142,6 +148,8 @@ static int ratbagd_led_set_color(sd_bus *bus,
 	struct ratbag_color c;
 	int r;
 
+	verify_device_idle(led->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, "(uuu)", &c.red, &c.green, &c.blue));
 
 	if (c.red > 255)
@@ -154,12 +162,11 @@ static int ratbagd_led_set_color(sd_bus *bus,
 	r = ratbag_led_set_color(led->lib_led, c);
 
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       led->path,
-					       RATBAGD_NAME_ROOT ".Led",
-					       "Color",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(led->device),
+					   led->path,
+					   RATBAGD_NAME_ROOT ".Led",
+					   "Color",
+					   NULL);
 	}
 
 	return 0;
@@ -176,6 +183,8 @@ static int ratbagd_led_get_effect_duration(sd_bus *bus,
 	struct ratbagd_led *led = userdata;
 	int rate;
 
+	verify_device_idle(led->device, error);
+
 	rate = ratbag_led_get_effect_duration(led->lib_led);
 
 	verify_unsigned_int(rate);
@@ -197,6 +206,8 @@ static int ratbagd_led_set_effect_duration(sd_bus *bus,
 	unsigned int rate;
 	int r;
 
+	verify_device_idle(led->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, "u", &rate));
 
 	if (rate > 10000)
@@ -205,12 +216,11 @@ static int ratbagd_led_set_effect_duration(sd_bus *bus,
 	r = ratbag_led_set_effect_duration(led->lib_led, rate);
 
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       led->path,
-					       RATBAGD_NAME_ROOT ".Led",
-					       "EffectDuration",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(led->device),
+					   led->path,
+					   RATBAGD_NAME_ROOT ".Led",
+					   "EffectDuration",
+					   NULL);
 	}
 
 	return 0;
@@ -227,6 +237,8 @@ static int ratbagd_led_get_brightness(sd_bus *bus,
 	struct ratbagd_led *led = userdata;
 	unsigned int brightness;
 
+	verify_device_idle(led->device, error);
+
 	brightness = ratbag_led_get_brightness(led->lib_led);
 
 	verify_unsigned_int(brightness);
@@ -248,6 +260,8 @@ static int ratbagd_led_set_brightness(sd_bus *bus,
 	unsigned int brightness;
 	int r;
 
+	verify_device_idle(led->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, "u", &brightness));
 
 	if (brightness > 255)
@@ -256,12 +270,11 @@ static int ratbagd_led_set_brightness(sd_bus *bus,
 	r = ratbag_led_set_brightness(led->lib_led, brightness);
 
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       led->path,
-					       RATBAGD_NAME_ROOT ".Led",
-					       "Brightness",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(led->device),
+					   led->path,
+					   RATBAGD_NAME_ROOT ".Led",
+					   "Brightness",
+					   NULL);
 	}
 
 	return 0;
@@ -303,6 +316,7 @@ int ratbagd_led_new(struct ratbagd_led **out,
 	assert(lib_led);
 
 	led = zalloc(sizeof(*led));
+	led->device = device;
 	led->lib_led = lib_led;
 	led->index = index;
 	led->colordepth = ratbag_led_get_colordepth(lib_led);
@@ -342,12 +356,14 @@ struct ratbagd_led *ratbagd_led_free(struct ratbagd_led *led)
 int ratbagd_led_resync(sd_bus *bus,
 		       struct ratbagd_led *led)
 {
-	return sd_bus_emit_properties_changed(bus,
-					      led->path,
-					      RATBAGD_NAME_ROOT ".Led",
-					      "Mode",
-					      "Color",
-					      "EffectDuration",
-					      "Brightness",
-					      NULL);
+	ratbagd_properties_changed(ratbagd_device_get_ctx(led->device),
+				   led->path,
+				   RATBAGD_NAME_ROOT ".Led",
+				   "Mode",
+				   "Color",
+				   "EffectDuration",
+				   "Brightness",
+				   NULL);
+
+	return 0;
 }
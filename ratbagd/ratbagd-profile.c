@@ -191,6 +191,8 @@ static int ratbagd_profile_is_active(sd_bus *bus,
 	struct ratbagd_profile *profile = userdata;
 	int is_active;
 
+	verify_device_idle(profile->device, error);
+
 	is_active = ratbag_profile_is_active(profile->lib_profile);
 
 	CHECK_CALL(sd_bus_message_append(reply, "b", is_active));
@@ -265,11 +267,11 @@ static int ratbagd_profile_active_signal_cb(sd_bus *bus,
 {
 	/* FIXME: we should cache is active and only send the signal for
 	 * those profiles where it changed */
-	(void) sd_bus_emit_properties_changed(bus,
-					      profile->path,
-					      RATBAGD_NAME_ROOT ".Profile",
-					      "IsActive",
-					      NULL);
+	ratbagd_properties_changed(ratbagd_device_get_ctx(profile->device),
+				   profile->path,
+				   RATBAGD_NAME_ROOT ".Profile",
+				   "IsActive",
+				   NULL);
 
 	return 0;
 }
@@ -281,6 +283,8 @@ static int ratbagd_profile_set_active(sd_bus_message *m,
 	struct ratbagd_profile *profile = userdata;
 	int r;
 
+	verify_device_idle(profile->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, ""));
 
 	r = ratbag_profile_set_active(profile->lib_profile);
@@ -313,16 +317,17 @@ ratbagd_profile_set_enabled(sd_bus *bus,
 	int enabled;
 	int r;
 
+	verify_device_idle(profile->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, "b", &enabled));
 
 	r = ratbag_profile_set_enabled(profile->lib_profile, enabled);
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       profile->path,
-					       RATBAGD_NAME_ROOT ".Profile",
-					       "Enabled",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(profile->device),
+					   profile->path,
+					   RATBAGD_NAME_ROOT ".Profile",
+					   "Enabled",
+					   NULL);
 	}
 
 	return 0;
@@ -338,7 +343,11 @@ ratbagd_profile_is_enabled(sd_bus *bus,
 			   sd_bus_error *error)
 {
 	struct ratbagd_profile *profile = userdata;
-	int enabled = ratbag_profile_is_enabled(profile->lib_profile) != 0;
+	int enabled;
+
+	verify_device_idle(profile->device, error);
+
+	enabled = ratbag_profile_is_enabled(profile->lib_profile) != 0;
 
 	CHECK_CALL(sd_bus_message_append(reply, "b", enabled));
 
@@ -358,16 +367,18 @@ ratbagd_profile_set_name(sd_bus *bus,
 	char *name;
 	int r;
 
+	verify_device_idle(profile->device, error);
+
 	CHECK_CALL(sd_bus_message_read(m, "s", &name));
 
 	r = ratbag_profile_set_name(profile->lib_profile, name);
 
 	if (r == 0) {
-		sd_bus_emit_properties_changed(bus,
-					       profile->path,
-					       RATBAGD_NAME_ROOT ".Profile",
-					       "Name",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(profile->device),
+					   profile->path,
+					   RATBAGD_NAME_ROOT ".Profile",
+					   "Name",
+					   NULL);
 	}
 
 	return 0;
@@ -383,9 +394,12 @@ ratbagd_profile_get_name(sd_bus *bus,
 			 sd_bus_error *error)
 {
 	struct ratbagd_profile *profile = userdata;
-	const char *name = ratbag_profile_get_name(profile->lib_profile);
+	const char *name;
 	_cleanup_free_ char *utf8 = NULL;
 
+	verify_device_idle(profile->device, error);
+
+	name = ratbag_profile_get_name(profile->lib_profile);
 	if (name) {
 		if (u8_check((const uint8_t*)name, strlen(name)) == NULL)
 			utf8 = strdup(name);
@@ -450,6 +464,8 @@ ratbagd_profile_get_report_rate(sd_bus *bus,
 	struct ratbag_profile *lib_profile = profile->lib_profile;
 	int rate;
 
+	verify_device_idle(profile->device, error);
+
 	rate = ratbag_profile_get_report_rate(lib_profile);
 	verify_unsigned_int(rate);
 	return sd_bus_message_append(reply, "u", rate);
@@ -502,6 +518,8 @@ ratbagd_profile_set_report_rate(sd_bus *bus,
 	unsigned int rate;
 	int r;
 
+	verify_device_idle(profile->device, error);
+
 	r = sd_bus_message_read(m, "u", &rate);
 	if (r < 0)
 		return r;
@@ -514,12 +532,11 @@ ratbagd_profile_set_report_rate(sd_bus *bus,
 
 	r = ratbag_profile_set_report_rate(profile->lib_profile, rate);
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       profile->path,
-					       RATBAGD_NAME_ROOT ".Profile",
-					       "ReportRate",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(profile->device),
+					   profile->path,
+					   RATBAGD_NAME_ROOT ".Profile",
+					   "ReportRate",
+					   NULL);
 	}
 
 	return 0;
@@ -934,12 +951,198 @@ int ratbagd_profile_resync(sd_bus *bus,
 	ratbagd_for_each_button_signal(bus, profile, ratbagd_button_resync);
 	ratbagd_for_each_led_signal(bus, profile, ratbagd_led_resync);
 
-	return sd_bus_emit_properties_changed(bus,
+	ratbagd_properties_changed(ratbagd_device_get_ctx(profile->device),
+				   profile->path,
+				   RATBAGD_NAME_ROOT ".Profile",
+				   "Name",
+				   "Enabled",
+				   "IsActive",
+				   "ReportRate",
+				   NULL);
+
+	return 0;
+}
+
+static int
+ratbagd_profile_open_children(sd_bus_message *reply, const char *key)
+{
+	CHECK_CALL(sd_bus_message_open_container(reply, 'e', "sv"));
+	CHECK_CALL(sd_bus_message_append(reply, "s", key));
+	CHECK_CALL(sd_bus_message_open_container(reply, 'v', "aa{sv}"));
+	CHECK_CALL(sd_bus_message_open_container(reply, 'a', "a{sv}"));
+
+	return 0;
+}
+
+static int
+ratbagd_profile_close_children(sd_bus_message *reply)
+{
+	CHECK_CALL(sd_bus_message_close_container(reply));
+	CHECK_CALL(sd_bus_message_close_container(reply));
+	CHECK_CALL(sd_bus_message_close_container(reply));
+
+	return 0;
+}
+
+int ratbagd_profile_snapshot(sd_bus_message *reply,
+			     struct ratbagd_profile *profile,
+			     sd_bus_error *error)
+{
+	unsigned int i;
+
+	CHECK_CALL(sd_bus_message_open_container(reply, 'a', "{sv}"));
+	CHECK_CALL(ratbagd_snapshot_append(reply,
+					   ratbagd_profile_vtable,
+					   profile->path,
+					   RATBAGD_NAME_ROOT ".Profile",
+					   profile,
+					   error));
+
+	CHECK_CALL(ratbagd_profile_open_children(reply, "Resolutions"));
+	for (i = 0; i < profile->n_resolutions; i++) {
+		struct ratbagd_resolution *resolution = profile->resolutions[i];
+
+		if (!resolution)
+			continue;
+
+		CHECK_CALL(ratbagd_snapshot_append_object(reply,
+							  ratbagd_resolution_vtable,
+							  ratbagd_resolution_get_path(resolution),
+							  RATBAGD_NAME_ROOT ".Resolution",
+							  resolution,
+							  error));
+	}
+	CHECK_CALL(ratbagd_profile_close_children(reply));
+
+	CHECK_CALL(ratbagd_profile_open_children(reply, "Buttons"));
+	for (i = 0; i < profile->n_buttons; i++) {
+		struct ratbagd_button *button = profile->buttons[i];
+
+		if (!button)
+			continue;
+
+		CHECK_CALL(ratbagd_snapshot_append_object(reply,
+							  ratbagd_button_vtable,
+							  ratbagd_button_get_path(button),
+							  RATBAGD_NAME_ROOT ".Button",
+							  button,
+							  error));
+	}
+	CHECK_CALL(ratbagd_profile_close_children(reply));
+
+	CHECK_CALL(ratbagd_profile_open_children(reply, "Leds"));
+	for (i = 0; i < profile->n_leds; i++) {
+		struct ratbagd_led *led = profile->leds[i];
+
+		if (!led)
+			continue;
+
+		CHECK_CALL(ratbagd_snapshot_append_object(reply,
+							  ratbagd_led_vtable,
+							  ratbagd_led_get_path(led),
+							  RATBAGD_NAME_ROOT ".Led",
+							  led,
+							  error));
+	}
+	CHECK_CALL(ratbagd_profile_close_children(reply));
+
+	CHECK_CALL(sd_bus_message_close_container(reply));
+
+	return 0;
+}
+
+static int
+ratbagd_profile_apply_object(sd_bus_message *m,
+			     const char *path,
+			     void *userdata,
+			     sd_bus_error *error)
+{
+	struct ratbagd_profile *profile = userdata;
+	unsigned int i;
+
+	for (i = 0; i < profile->n_resolutions; i++) {
+		struct ratbagd_resolution *resolution = profile->resolutions[i];
+
+		if (!resolution ||
+		    !streq(ratbagd_resolution_get_path(resolution), path))
+			continue;
+
+		CHECK_CALL(ratbagd_snapshot_apply_entries(m,
+							  ratbagd_resolution_vtable,
+							  path,
+							  RATBAGD_NAME_ROOT ".Resolution",
+							  resolution,
+							  NULL,
+							  error));
+		return 1;
+	}
+
+	for (i = 0; i < profile->n_buttons; i++) {
+		struct ratbagd_button *button = profile->buttons[i];
+
+		if (!button || !streq(ratbagd_button_get_path(button), path))
+			continue;
+
+		CHECK_CALL(ratbagd_snapshot_apply_entries(m,
+							  ratbagd_button_vtable,
+							  path,
+							  RATBAGD_NAME_ROOT ".Button",
+							  button,
+							  NULL,
+							  error));
+		return 1;
+	}
+
+	for (i = 0; i < profile->n_leds; i++) {
+		struct ratbagd_led *led = profile->leds[i];
+
+		if (!led || !streq(ratbagd_led_get_path(led), path))
+			continue;
+
+		CHECK_CALL(ratbagd_snapshot_apply_entries(m,
+							  ratbagd_led_vtable,
+							  path,
+							  RATBAGD_NAME_ROOT ".Led",
+							  led,
+							  NULL,
+							  error));
+		return 1;
+	}
+
+	/* not one of ours, nothing to apply it to */
+	return 0;
+}
+
+static int
+ratbagd_profile_apply_children(sd_bus_message *m,
+			       const char *key,
+			       void *userdata,
+			       sd_bus_error *error)
+{
+	if (!streq(key, "Resolutions") &&
+	    !streq(key, "Buttons") &&
+	    !streq(key, "Leds"))
+		return 0;
+
+	CHECK_CALL(ratbagd_snapshot_apply_children(m,
+						   ratbagd_profile_apply_object,
+						   userdata,
+						   error));
+
+	return 1;
+}
+
+/* The message is positioned inside the profile's snapshot, the caller
+ * matched it to this profile by its Path */
+int ratbagd_profile_apply_snapshot(sd_bus_message *m,
+				   struct ratbagd_profile *profile,
+				   sd_bus_error *error)
+{
+	return ratbagd_snapshot_apply_entries(m,
+					      ratbagd_profile_vtable,
 					      profile->path,
 					      RATBAGD_NAME_ROOT ".Profile",
-					      "Resolutions",
-					      "Buttons",
-					      "Leds",
-					      "IsActive",
-					      NULL);
+					      profile,
+					      ratbagd_profile_apply_children,
+					      error);
 }
@@ -48,14 +48,15 @@ struct ratbagd_resolution {
 int ratbagd_resolution_resync(sd_bus *bus,
 			      struct ratbagd_resolution *resolution)
 {
-	return sd_bus_emit_properties_changed(bus,
-					      resolution->path,
-					      RATBAGD_NAME_ROOT ".Resolution",
-					      "IsDefault",
-					      "Resolution",
-					      "ReportRate",
-					      "IsActive",
-					      NULL);
+	ratbagd_properties_changed(ratbagd_device_get_ctx(resolution->device),
+				   resolution->path,
+				   RATBAGD_NAME_ROOT ".Resolution",
+				   "IsDefault",
+				   "Resolution",
+				   "IsActive",
+				   NULL);
+
+	return 0;
 }
 
 static int ratbagd_resolution_active_signal_cb(sd_bus *bus,
@@ -64,11 +65,11 @@ static int ratbagd_resolution_active_signal_cb(sd_bus *bus,
 	/* FIXME: we should cache is_active and only send the signal for
 	 * those resolutions where it changed */
 
-	(void) sd_bus_emit_properties_changed(bus,
-					      resolution->path,
-					      RATBAGD_NAME_ROOT ".Resolution",
-					      "IsActive",
-					      NULL);
+	ratbagd_properties_changed(ratbagd_device_get_ctx(resolution->device),
+				   resolution->path,
+				   RATBAGD_NAME_ROOT ".Resolution",
+				   "IsActive",
+				   NULL);
 
 	return 0;
 }
@@ -80,6 +81,8 @@ static int ratbagd_resolution_set_active(sd_bus_message *m,
 	struct ratbagd_resolution *resolution = userdata;
 	int r;
 
+	verify_device_idle(resolution->device, error);
+
 	r = ratbag_resolution_set_active(resolution->lib_resolution);
 	if (r < 0) {
 		sd_bus *bus = sd_bus_message_get_bus(m);
@@ -101,11 +104,11 @@ static int ratbagd_resolution_default_signal_cb(sd_bus *bus,
 	/* FIXME: we should cache is default and only send the signal for
 	 * those resolutions where it changed */
 
-	(void) sd_bus_emit_properties_changed(bus,
-					      resolution->path,
-					      RATBAGD_NAME_ROOT ".Resolution",
-					      "IsDefault",
-					      NULL);
+	ratbagd_properties_changed(ratbagd_device_get_ctx(resolution->device),
+				   resolution->path,
+				   RATBAGD_NAME_ROOT ".Resolution",
+				   "IsDefault",
+				   NULL);
 
 	return 0;
 }
@@ -117,6 +120,8 @@ static int ratbagd_resolution_set_default(sd_bus_message *m,
 	struct ratbagd_resolution *resolution = userdata;
 	int r;
 
+	verify_device_idle(resolution->device, error);
+
 	r = ratbag_resolution_set_default(resolution->lib_resolution);
 	if (r < 0) {
 		sd_bus *bus = sd_bus_message_get_bus(m);
@@ -145,6 +150,8 @@ ratbagd_resolution_is_active(sd_bus *bus,
 	struct ratbag_resolution *lib_resolution = resolution->lib_resolution;
 	int is_active;
 
+	verify_device_idle(resolution->device, error);
+
 	is_active = ratbag_resolution_is_active(lib_resolution);
 
 	return sd_bus_message_append(reply, "b", is_active);
@@ -163,6 +170,8 @@ ratbagd_resolution_is_default(sd_bus *bus,
 	struct ratbag_resolution *lib_resolution = resolution->lib_resolution;
 	int is_default;
 
+	verify_device_idle(resolution->device, error);
+
 	is_default = ratbag_resolution_is_default(lib_resolution);
 
 	return sd_bus_message_append(reply, "b", is_default);
@@ -179,8 +188,10 @@ ratbagd_resolution_get_resolutions(sd_bus *bus,
 {
 	struct ratbagd_resolution *resolution = userdata;
 	struct ratbag_resolution *lib_resolution = resolution->lib_resolution;
-	unsigned int dpis[300];
-	unsigned int ndpis = ARRAY_LENGTH(dpis);
+	unsigned int buf[300];
+	unsigned int *dpis = buf;
+	_cleanup_(freep) unsigned int *heap = NULL;
+	size_t ndpis;
 	int r;
 
 	r = sd_bus_message_open_container(reply, 'a', "u");
@@ -188,8 +199,12 @@ ratbagd_resolution_get_resolutions(sd_bus *bus,
 		return r;
 
 	ndpis = ratbag_resolution_get_dpi_list(lib_resolution,
-					       dpis, ndpis);
-	assert(ndpis <= ARRAY_LENGTH(dpis));
+					       buf, ARRAY_LENGTH(buf));
+	if (ndpis > ARRAY_LENGTH(buf)) {
+		heap = zalloc(ndpis * sizeof(*heap));
+		ratbag_resolution_get_dpi_list(lib_resolution, heap, ndpis);
+		dpis = heap;
+	}
 
 	for (unsigned int i = 0; i < ndpis; i++) {
 		verify_unsigned_int(dpis[i]);
@@ -214,6 +229,8 @@ ratbagd_resolution_get_resolution(sd_bus *bus,
 	struct ratbag_resolution *lib_resolution = resolution->lib_resolution;
 	int xres, yres;
 
+	verify_device_idle(resolution->device, error);
+
 
 	xres = ratbag_resolution_get_dpi_x(lib_resolution);
 	yres = ratbag_resolution_get_dpi_y(lib_resolution);
@@ -243,6 +260,8 @@ ratbagd_resolution_set_resolution(sd_bus *bus,
 	int xres, yres;
 	int r;
 
+	verify_device_idle(resolution->device, error);
+
 	if (ratbag_resolution_has_capability(lib_resolution, cap)) {
 		CHECK_CALL(sd_bus_message_read(m, "v", "(uu)", &xres, &yres));
 		r = ratbag_resolution_set_dpi_xy(resolution->lib_resolution,
@@ -253,12 +272,11 @@ ratbagd_resolution_set_resolution(sd_bus *bus,
 	}
 
 	if (r == 0) {
-		sd_bus *bus = sd_bus_message_get_bus(m);
-		sd_bus_emit_properties_changed(bus,
-					       resolution->path,
-					       RATBAGD_NAME_ROOT ".Resolution",
-					       "Resolution",
-					       NULL);
+		ratbagd_properties_changed(ratbagd_device_get_ctx(resolution->device),
+					   resolution->path,
+					   RATBAGD_NAME_ROOT ".Resolution",
+					   "Resolution",
+					   NULL);
 	}
 
 	return 0;
@@ -0,0 +1,308 @@
+/***
+  This file is part of ratbagd.
+
+  Permission is hereby granted, free of charge, to any person obtaining a
+  copy of this software and associated documentation files (the "Software"),
+  to deal in the Software without restriction, including without limitation
+  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom the
+  Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice (including the next
+  paragraph) shall be included in all copies or substantial portions of the
+  Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+  DEALINGS IN THE SOFTWARE.
+***/
+
+/*
+ * Snapshots serialize an object into an a{sv} by walking its vtable, so
+ * the snapshot always carries the same properties with the same
+ * signatures as the individual objects do. Properties listing child
+ * objects ("ao") are left out, the caller nests the child snapshots
+ * under the same key instead.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <systemd/sd-bus.h>
+#include "ratbagd.h"
+#include "shared-macro.h"
+#include "libratbag-util.h"
+
+static inline bool
+ratbagd_snapshot_is_property(const sd_bus_vtable *v)
+{
+	return v->type == _SD_BUS_VTABLE_PROPERTY ||
+	       v->type == _SD_BUS_VTABLE_WRITABLE_PROPERTY;
+}
+
+static inline bool
+ratbagd_snapshot_is_child_list(const sd_bus_vtable *v)
+{
+	return streq(v->x.property.signature, "ao");
+}
+
+/* Properties without a getter use the sd-bus default getter, which
+ * reads the value straight out of the object. We only have those for
+ * plain integers. */
+static int
+ratbagd_snapshot_append_offset(sd_bus_message *reply,
+			       const sd_bus_vtable *v,
+			       void *userdata)
+{
+	const void *p = (const uint8_t *)userdata + v->x.property.offset;
+	const char *signature = v->x.property.signature;
+
+	if (streq(signature, "u"))
+		return sd_bus_message_append(reply, "u", *(const uint32_t *)p);
+	if (streq(signature, "i"))
+		return sd_bus_message_append(reply, "i", *(const int32_t *)p);
+	if (streq(signature, "b"))
+		return sd_bus_message_append(reply, "b", *(const int *)p);
+
+	log_error("%s: unsupported signature '%s' for %s\n",
+		  __func__, signature, v->x.property.member);
+	return -EINVAL;
+}
+
+int ratbagd_snapshot_append(sd_bus_message *reply,
+			    const sd_bus_vtable *vtable,
+			    const char *path,
+			    const char *interface,
+			    void *userdata,
+			    sd_bus_error *error)
+{
+	sd_bus *bus = sd_bus_message_get_bus(reply);
+	const sd_bus_vtable *v;
+
+	CHECK_CALL(sd_bus_message_append(reply, "{sv}", "Path", "o", path));
+
+	for (v = vtable; v->type != _SD_BUS_VTABLE_END; v++) {
+		const char *member, *signature;
+
+		if (!ratbagd_snapshot_is_property(v) ||
+		    ratbagd_snapshot_is_child_list(v))
+			continue;
+
+		member = v->x.property.member;
+		signature = v->x.property.signature;
+
+		CHECK_CALL(sd_bus_message_open_container(reply, 'e', "sv"));
+		CHECK_CALL(sd_bus_message_append(reply, "s", member));
+		CHECK_CALL(sd_bus_message_open_container(reply, 'v', signature));
+
+		if (v->x.property.get)
+			CHECK_CALL(v->x.property.get(bus, path, interface,
+						     member, reply, userdata,
+						     error));
+		else
+			CHECK_CALL(ratbagd_snapshot_append_offset(reply, v,
+								  userdata));
+
+		CHECK_CALL(sd_bus_message_close_container(reply));
+		CHECK_CALL(sd_bus_message_close_container(reply));
+	}
+
+	return 0;
+}
+
+int ratbagd_snapshot_append_object(sd_bus_message *reply,
+				   const sd_bus_vtable *vtable,
+				   const char *path,
+				   const char *interface,
+				   void *userdata,
+				   sd_bus_error *error)
+{
+	CHECK_CALL(sd_bus_message_open_container(reply, 'a', "{sv}"));
+	CHECK_CALL(ratbagd_snapshot_append(reply, vtable, path, interface,
+					   userdata, error));
+	CHECK_CALL(sd_bus_message_close_container(reply));
+
+	return 0;
+}
+
+static const sd_bus_vtable *
+ratbagd_snapshot_find_writable(const sd_bus_vtable *vtable,
+			       const char *member)
+{
+	const sd_bus_vtable *v;
+
+	for (v = vtable; v->type != _SD_BUS_VTABLE_END; v++) {
+		if (v->type == _SD_BUS_VTABLE_WRITABLE_PROPERTY &&
+		    streq(v->x.property.member, member))
+			return v;
+	}
+
+	return NULL;
+}
+
+/* Applies the variant the message currently points at to the property
+ * named member. Returns 1 if the property was set, 0 if the property is
+ * unknown or read-only and the value was skipped. */
+static int
+ratbagd_snapshot_apply_property(sd_bus_message *m,
+				const sd_bus_vtable *vtable,
+				const char *path,
+				const char *interface,
+				const char *member,
+				void *userdata,
+				sd_bus_error *error)
+{
+	sd_bus *bus = sd_bus_message_get_bus(m);
+	const sd_bus_vtable *v;
+	const char *contents;
+	char type;
+
+	v = ratbagd_snapshot_find_writable(vtable, member);
+	if (!v) {
+		CHECK_CALL(sd_bus_message_skip(m, "v"));
+		return 0;
+	}
+
+	CHECK_CALL(sd_bus_message_peek_type(m, &type, &contents));
+	if (type != SD_BUS_TYPE_VARIANT ||
+	    !streq(contents, v->x.property.signature))
+		return sd_bus_error_setf(error,
+					 SD_BUS_ERROR_INVALID_ARGS,
+					 "%s: expected signature '%s' for %s",
+					 path,
+					 v->x.property.signature,
+					 member);
+
+	CHECK_CALL(sd_bus_message_enter_container(m, 'v', contents));
+	CHECK_CALL(v->x.property.set(bus, path, interface, member, m,
+				     userdata, error));
+	CHECK_CALL(sd_bus_message_exit_container(m));
+
+	return 1;
+}
+
+int ratbagd_snapshot_apply_entries(sd_bus_message *m,
+				   const sd_bus_vtable *vtable,
+				   const char *path,
+				   const char *interface,
+				   void *userdata,
+				   ratbagd_snapshot_child_t apply_child,
+				   sd_bus_error *error)
+{
+	const char *key;
+	int r;
+
+	while ((r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+		CHECK_CALL(sd_bus_message_read(m, "s", &key));
+
+		r = 0;
+		if (apply_child)
+			r = apply_child(m, key, userdata, error);
+		if (r == 0)
+			r = ratbagd_snapshot_apply_property(m, vtable, path,
+							    interface, key,
+							    userdata, error);
+		if (r < 0)
+			return r;
+
+		CHECK_CALL(sd_bus_message_exit_container(m));
+	}
+
+	return r;
+}
+
+int ratbagd_snapshot_apply(sd_bus_message *m,
+			   const sd_bus_vtable *vtable,
+			   const char *path,
+			   const char *interface,
+			   void *userdata,
+			   ratbagd_snapshot_child_t apply_child,
+			   sd_bus_error *error)
+{
+	CHECK_CALL(sd_bus_message_enter_container(m, 'a', "{sv}"));
+	CHECK_CALL(ratbagd_snapshot_apply_entries(m, vtable, path, interface,
+						  userdata, apply_child,
+						  error));
+	CHECK_CALL(sd_bus_message_exit_container(m));
+
+	return 0;
+}
+
+/* Finds the Path entry of the object snapshot the message is in and
+ * rewinds to its first entry. path is NULL if there is none. */
+static int
+ratbagd_snapshot_read_path(sd_bus_message *m, const char **path)
+{
+	const char *key;
+	int r;
+
+	*path = NULL;
+
+	while ((r = sd_bus_message_enter_container(m, 'e', "sv")) > 0) {
+		CHECK_CALL(sd_bus_message_read(m, "s", &key));
+
+		if (streq(key, "Path"))
+			CHECK_CALL(sd_bus_message_read(m, "v", "o", path));
+		else
+			CHECK_CALL(sd_bus_message_skip(m, "v"));
+
+		CHECK_CALL(sd_bus_message_exit_container(m));
+	}
+	if (r < 0)
+		return r;
+
+	return sd_bus_message_rewind(m, false);
+}
+
+static int
+ratbagd_snapshot_skip_entries(sd_bus_message *m)
+{
+	int r;
+
+	while ((r = sd_bus_message_at_end(m, false)) == 0)
+		CHECK_CALL(sd_bus_message_skip(m, "{sv}"));
+
+	return r < 0 ? r : 0;
+}
+
+/* Child snapshots are matched to objects by their Path, a child may be
+ * missing from the snapshot or be one we don't have (anymore). */
+int ratbagd_snapshot_apply_children(sd_bus_message *m,
+				    ratbagd_snapshot_object_t apply_object,
+				    void *userdata,
+				    sd_bus_error *error)
+{
+	const char *path;
+	int r;
+
+	CHECK_CALL(sd_bus_message_enter_container(m, 'v', "aa{sv}"));
+	CHECK_CALL(sd_bus_message_enter_container(m, 'a', "a{sv}"));
+
+	while ((r = sd_bus_message_enter_container(m, 'a', "{sv}")) > 0) {
+		CHECK_CALL(ratbagd_snapshot_read_path(m, &path));
+
+		r = 0;
+		if (path)
+			r = apply_object(m, path, userdata, error);
+		if (r == 0)
+			r = ratbagd_snapshot_skip_entries(m);
+		if (r < 0)
+			return r;
+
+		CHECK_CALL(sd_bus_message_exit_container(m));
+	}
+	if (r < 0)
+		return r;
+
+	CHECK_CALL(sd_bus_message_exit_container(m));
+	CHECK_CALL(sd_bus_message_exit_container(m));
+
+	return 0;
+}
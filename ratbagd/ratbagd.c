@@ -32,6 +32,7 @@
 #include <libgen.h>
 #include <libratbag.h>
 #include <libudev.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/resource.h>
@@ -284,10 +285,14 @@ static struct ratbagd *ratbagd_free(struct ratbagd *ctx)
 		return NULL;
 
 	RATBAGD_DEVICE_FOREACH_SAFE(device, tmp, ctx) {
+		ratbagd_device_commit_wait(device);
 		ratbagd_device_unlink(device);
 		ratbagd_device_unref(device);
 	}
 
+	ratbagd_properties_changed_flush(ctx);
+	ctx->changed_source = sd_event_source_unref(ctx->changed_source);
+
 	ctx->bus = sd_bus_flush_close_unref(ctx->bus);
 	ctx->monitor_source = sd_event_source_unref(ctx->monitor_source);
 	ctx->monitor = udev_monitor_unref(ctx->monitor);
@@ -699,3 +704,126 @@ void ratbagd_schedule_task(struct ratbagd *ctx,
 
 	sd_event_add_post(ctx->event, &source, ratbagd_callback_handler, cb);
 }
+
+/* Beyond this many properties on one object we just let sd-bus emit
+ * all of the object's properties */
+#define RATBAGD_CHANGED_MAX 16
+
+struct ratbagd_changed {
+	struct ratbagd_changed *next;
+	char *path;
+	const char *interface;
+	bool all;
+	size_t n_properties;
+	char *properties[RATBAGD_CHANGED_MAX + 1]; /* NULL-terminated */
+};
+
+void ratbagd_properties_changed_flush(struct ratbagd *ctx)
+{
+	struct ratbagd_changed *changed;
+
+	while ((changed = ctx->changed)) {
+		ctx->changed = changed->next;
+
+		/* the object may be gone by now, nothing to do about it */
+		(void) sd_bus_emit_properties_changed_strv(ctx->bus,
+							   changed->path,
+							   changed->interface,
+							   changed->all ? NULL : changed->properties);
+		free(changed->path);
+		free(changed);
+	}
+}
+
+static int ratbagd_changed_handler(sd_event_source *s, void *userdata)
+{
+	struct ratbagd *ctx = userdata;
+
+	ratbagd_properties_changed_flush(ctx);
+
+	return 0;
+}
+
+static struct ratbagd_changed *
+ratbagd_changed_get(struct ratbagd *ctx,
+		    const char *path,
+		    const char *interface)
+{
+	struct ratbagd_changed *changed;
+
+	for (changed = ctx->changed; changed; changed = changed->next) {
+		if (streq(changed->path, path) &&
+		    streq(changed->interface, interface))
+			return changed;
+	}
+
+	changed = zalloc(sizeof(*changed));
+	changed->path = strdup_safe(path);
+	changed->interface = interface;
+	changed->next = ctx->changed;
+	ctx->changed = changed;
+
+	return changed;
+}
+
+static void ratbagd_changed_add(struct ratbagd_changed *changed,
+				const char *property)
+{
+	size_t i;
+
+	if (changed->all)
+		return;
+
+	for (i = 0; i < changed->n_properties; i++) {
+		if (streq(changed->properties[i], property))
+			return;
+	}
+
+	if (changed->n_properties == RATBAGD_CHANGED_MAX) {
+		changed->all = true;
+		return;
+	}
+
+	changed->properties[changed->n_properties++] = (char *)property;
+}
+
+/**
+ * Queue a PropertiesChanged signal for the given properties, terminated
+ * by NULL. Signals are collected for the current event loop iteration
+ * and sent once per object when it ends, so a client changing dozens
+ * of properties in a row only sees one signal per object.
+ *
+ * The interface and property names must be static strings, as they are
+ * in the vtables.
+ */
+void ratbagd_properties_changed(struct ratbagd *ctx,
+				const char *path,
+				const char *interface,
+				const char *property,
+				...)
+{
+	struct ratbagd_changed *changed;
+	va_list args;
+	int r;
+
+	if (!ctx->changed_source) {
+		r = sd_event_add_post(ctx->event,
+				      &ctx->changed_source,
+				      ratbagd_changed_handler,
+				      ctx);
+		if (r < 0) {
+			errno = -r;
+			log_error("Failed to queue PropertiesChanged: %m\n");
+			return;
+		}
+	}
+
+	changed = ratbagd_changed_get(ctx, path, interface);
+
+	va_start(args, property);
+	for (; property; property = va_arg(args, const char *))
+		ratbagd_changed_add(changed, property);
+	va_end(args);
+
+	sd_event_source_set_enabled(ctx->changed_source, SD_EVENT_ONESHOT);
+}
@@ -109,6 +109,12 @@ int ratbagd_for_each_led_signal(sd_bus *bus,
 				int (*func)(sd_bus *bus,
 					    struct ratbagd_led *led));
 int ratbagd_profile_resync(sd_bus *bus, struct ratbagd_profile *profile);
+int ratbagd_profile_snapshot(sd_bus_message *reply,
+			     struct ratbagd_profile *profile,
+			     sd_bus_error *error);
+int ratbagd_profile_apply_snapshot(sd_bus_message *m,
+				   struct ratbagd_profile *profile,
+				   sd_bus_error *error);
 
 DEFINE_TRIVIAL_CLEANUP_FUNC(struct ratbagd_profile *, ratbagd_profile_free);
 
@@ -171,12 +177,15 @@ int ratbagd_device_new(struct ratbagd_device **out,
 		       const char *sysname,
 		       struct ratbag_device *lib_device);
 struct ratbagd_device *ratbagd_device_ref(struct ratbagd_device *device);
+struct ratbagd *ratbagd_device_get_ctx(struct ratbagd_device *device);
 struct ratbagd_device *ratbagd_device_unref(struct ratbagd_device *device);
 const char *ratbagd_device_get_sysname(struct ratbagd_device *device);
 const char *ratbagd_device_get_path(struct ratbagd_device *device);
 unsigned int ratbagd_device_get_num_buttons(struct ratbagd_device *device);
 unsigned int ratbagd_device_get_num_leds(struct ratbagd_device *device);
 int ratbagd_device_resync(struct ratbagd_device *device, sd_bus *bus);
+bool ratbagd_device_committing(struct ratbagd_device *device);
+void ratbagd_device_commit_wait(struct ratbagd_device *device);
 
 bool ratbagd_device_linked(struct ratbagd_device *device);
 void ratbagd_device_link(struct ratbagd_device *device);
@@ -201,6 +210,61 @@ struct ratbagd_device *ratbagd_device_next(struct ratbagd_device *device);
 	     _device = (_safe),				\
 	     _safe = (_safe) ? ratbagd_device_next(_safe) : NULL)
 
+/*
+ * Snapshots
+ */
+
+typedef int (*ratbagd_snapshot_child_t)(sd_bus_message *m,
+					const char *key,
+					void *userdata,
+					sd_bus_error *error);
+typedef int (*ratbagd_snapshot_object_t)(sd_bus_message *m,
+					 const char *path,
+					 void *userdata,
+					 sd_bus_error *error);
+
+int ratbagd_snapshot_append(sd_bus_message *reply,
+			    const sd_bus_vtable *vtable,
+			    const char *path,
+			    const char *interface,
+			    void *userdata,
+			    sd_bus_error *error);
+int ratbagd_snapshot_append_object(sd_bus_message *reply,
+				   const sd_bus_vtable *vtable,
+				   const char *path,
+				   const char *interface,
+				   void *userdata,
+				   sd_bus_error *error);
+int ratbagd_snapshot_apply(sd_bus_message *m,
+			   const sd_bus_vtable *vtable,
+			   const char *path,
+			   const char *interface,
+			   void *userdata,
+			   ratbagd_snapshot_child_t apply_child,
+			   sd_bus_error *error);
+int ratbagd_snapshot_apply_entries(sd_bus_message *m,
+				   const sd_bus_vtable *vtable,
+				   const char *path,
+				   const char *interface,
+				   void *userdata,
+				   ratbagd_snapshot_child_t apply_child,
+				   sd_bus_error *error);
+int ratbagd_snapshot_apply_children(sd_bus_message *m,
+				    ratbagd_snapshot_object_t apply_object,
+				    void *userdata,
+				    sd_bus_error *error);
+
+/* Changes to a device are refused while its commit runs on the worker
+ * thread, the worker owns the libratbag device until it completes. The
+ * same goes for reading properties a commit can change, or that make
+ * the driver talk to the device. Constant properties only read what
+ * the driver set up in probe and stay readable.
+ */
+#define verify_device_idle(_device, _error) \
+	do { if (ratbagd_device_committing(_device)) { \
+		return sd_bus_error_set_errno(_error, EBUSY); \
+	} } while(0)
+
 /* Verify that _val is not -1. This traps DBus API errors where we end up
  * sending a valid-looking index across and then fail on the other side.
  *
@@ -230,6 +294,10 @@ struct ratbagd {
 	RBTree device_map;
 	size_t n_devices;
 
+	/* PropertiesChanged signals queued for the end of the iteration */
+	sd_event_source *changed_source;
+	struct ratbagd_changed *changed;
+
 	const char **themes; /* NULL-terminated */
 };
 
@@ -238,3 +306,10 @@ typedef void (*ratbagd_callback_t)(void *userdata);
 void ratbagd_schedule_task(struct ratbagd *ctx,
 			   ratbagd_callback_t callback,
 			   void *userdata);
+
+void ratbagd_properties_changed(struct ratbagd *ctx,
+				const char *path,
+				const char *interface,
+				const char *property,
+				...) _sentinel_;
+void ratbagd_properties_changed_flush(struct ratbagd *ctx);
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2026 agent <agent@local>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+# DEALINGS IN THE SOFTWARE.
+#
+# Generates the slice-by-8 lookup tables of the HID++ CRC-CCITT included by
+# src/hidpp-crc.c:
+#
+#   T[0][v] = v << 8 shifted through the polynomial 8 times
+#   T[k][v] = (T[k-1][v] << 8) ^ T[0][T[k-1][v] >> 8]
+#
+
+import argparse
+
+POLYNOMIAL = 0x1021
+NTABLES = 8
+
+
+def crc_byte(v):
+    crc = v << 8
+    for _ in range(8):
+        crc = (crc << 1) ^ POLYNOMIAL if crc & 0x8000 else crc << 1
+    return crc & 0xffff
+
+
+def build_tables():
+    tables = [[crc_byte(v) for v in range(256)]]
+    for k in range(1, NTABLES):
+        prev = tables[k - 1]
+        tables.append([((prev[v] << 8) & 0xffff) ^ tables[0][prev[v] >> 8]
+                       for v in range(256)])
+    return tables
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='HID++ CRC table generator')
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    with open(args.output, 'w') as f:
+        f.write('/* generated by build-hidpp-crc-tables.py, do not edit */\n\n')
+        f.write('static const uint16_t hidpp_crc_ccitt_tables[{}][256] = {{\n'.format(NTABLES))
+        for table in build_tables():
+            f.write('\t{\n')
+            for i in range(0, 256, 8):
+                f.write('\t\t' + ', '.join('0x{:04x}'.format(v) for v in table[i:i + 8]) + ',\n')
+            f.write('\t},\n')
+        f.write('};\n')
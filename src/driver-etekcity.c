@@ -514,20 +514,22 @@ etekcity_write_macro(struct ratbag_button *button,
 	macro = &drv_data->macros[button->profile->index][button->index];
 	buf = (uint8_t*)macro;
 
-	for (i = 0; i < MAX_MACRO_EVENTS && count < ETEKCITY_MAX_MACRO_LENGTH; i++) {
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_INVALID)
+	for (i = 0; i < ratbag_macro_get_num_events(action->macro) && count < ETEKCITY_MAX_MACRO_LENGTH; i++) {
+		struct ratbag_macro_event event = ratbag_macro_get_event(action->macro, i);
+
+		if (event.type == RATBAG_MACRO_EVENT_INVALID)
 			return -EINVAL; /* should not happen, ever */
 
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_NONE)
+		if (event.type == RATBAG_MACRO_EVENT_NONE)
 			break;
 
 		/* ignore timeout events */
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_WAIT)
+		if (event.type == RATBAG_MACRO_EVENT_WAIT)
 			continue;
 
 		macro->keys[count].keycode = ratbag_hidraw_get_keyboard_usage_from_keycode(device,
-											   action->macro->events[i].event.key);
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_KEY_PRESSED)
+											   event.event.key);
+		if (event.type == RATBAG_MACRO_EVENT_KEY_PRESSED)
 			macro->keys[count].flag = 0x00;
 		else
 			macro->keys[count].flag = 0x80;
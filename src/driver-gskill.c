@@ -57,6 +57,14 @@
 #define GSKILL_CMD_FAILURE     0xb2
 #define GSKILL_CMD_IDLE        0xb3
 
+/*
+ * Time to wait for the device before asking for the command status.
+ * Spec says this should be 10ms, but 20ms seems to get the mouse to
+ * return slightly less nonsense responses
+ */
+#define GSKILL_CMD_MIN_DELAY_MS 20
+#define GSKILL_CMD_TIMEOUT_MS  500
+
 /* LED groups. DPI is omitted here since it's handled specially */
 #define GSKILL_LED_TYPE_LOGO  0
 #define GSKILL_LED_TYPE_WHEEL 1
@@ -317,6 +325,7 @@ struct gskill_profile_data {
 
 struct gskill_data {
 	uint8_t profile_count;
+	struct ratbag_poll_latency cmd_latency;
 	struct gskill_profile_data profile_data[GSKILL_PROFILE_MAX];
 };
 
@@ -368,11 +377,67 @@ gskill_calculate_checksum(const uint8_t *buf, size_t len)
 	return checksum;
 }
 
+struct gskill_cmd_status {
+	struct ratbag_device *device;
+	uint8_t *buf;
+};
+
+static int
+gskill_cmd_is_done(void *data)
+{
+	struct gskill_cmd_status *status = data;
+	struct ratbag_device *device = status->device;
+	uint8_t *buf = status->buf;
+	int rc;
+
+	rc = ratbag_hidraw_raw_request(device, 0, buf,
+				       GSKILL_REPORT_SIZE_CMD,
+				       HID_FEATURE_REPORT,
+				       HID_REQ_GET_REPORT);
+	/*
+	 * Sometimes the mouse just doesn't send anything when it wants
+	 * to tell us it's ready. In this case rc will be 0 and this
+	 * function will succeed.
+	 */
+	if (rc < GSKILL_REPORT_SIZE_CMD)
+		return rc;
+
+	/* Check the command status bit */
+	switch (buf[1]) {
+	case 0: /* sometimes the mouse gets lazy and just returns a
+		   blank buffer on success */
+	case GSKILL_CMD_SUCCESS:
+		return 0;
+
+	case GSKILL_CMD_IN_PROGRESS:
+		return -EAGAIN;
+
+	case GSKILL_CMD_IDLE:
+		log_error(device->ratbag,
+			  "Command response indicates idle status? Uh huh.\n");
+		return -EPROTO;
+
+	case GSKILL_CMD_FAILURE:
+		log_error(device->ratbag, "Command failed\n");
+		return -EIO;
+
+	default:
+		log_error(device->ratbag,
+			  "Received unknown command status from mouse: 0x%x\n",
+			  buf[1]);
+		return -EPROTO;
+	}
+}
+
 static int
 gskill_general_cmd(struct ratbag_device *device,
 		   uint8_t buf[GSKILL_REPORT_SIZE_CMD]) {
+	struct gskill_data *drv_data = device->drv_data;
+	struct gskill_cmd_status status = {
+		.device = device,
+		.buf = buf,
+	};
 	int rc;
-	int retries;
 
 	assert(buf[0] == GSKILL_GENERAL_CMD);
 
@@ -385,64 +450,14 @@ gskill_general_cmd(struct ratbag_device *device,
 		return rc < 0 ? rc : -EPROTO;
 	}
 
-	rc = -EAGAIN;
-	for (retries = 0; retries < 10 && rc == -EAGAIN; retries++) {
-		/*
-		 * Wait for the device to be ready
-		 * Spec says this should be 10ms, but 20ms seems to get the
-		 * mouse to return slightly less nonsense responses
-		 */
-		msleep(20);
-
-		rc = ratbag_hidraw_raw_request(device, 0, buf,
-					       GSKILL_REPORT_SIZE_CMD,
-					       HID_FEATURE_REPORT,
-					       HID_REQ_GET_REPORT);
-		/*
-		 * Sometimes the mouse just doesn't send anything when it wants
-		 * to tell us it's ready. In this case rc will be 0 and this
-		 * function will succeed.
-		 */
-		if (rc < GSKILL_REPORT_SIZE_CMD)
-			break;
-
-		/* Check the command status bit */
-		switch (buf[1]) {
-		case 0: /* sometimes the mouse gets lazy and just returns a
-			   blank buffer on success */
-		case GSKILL_CMD_SUCCESS:
-			rc = 0;
-			break;
-
-		case GSKILL_CMD_IN_PROGRESS:
-			rc = -EAGAIN;
-			continue;
-
-		case GSKILL_CMD_IDLE:
-			log_error(device->ratbag,
-				  "Command response indicates idle status? Uh huh.\n");
-			rc = -EPROTO;
-			break;
-
-		case GSKILL_CMD_FAILURE:
-			log_error(device->ratbag, "Command failed\n");
-			rc = -EIO;
-			break;
-
-		default:
-			log_error(device->ratbag,
-				  "Received unknown command status from mouse: 0x%x\n",
-				  buf[1]);
-			rc = -EPROTO;
-			break;
-		}
-	}
+	rc = ratbag_poll_ready(drv_data ? &drv_data->cmd_latency : NULL,
+			       GSKILL_CMD_MIN_DELAY_MS, GSKILL_CMD_TIMEOUT_MS,
+			       gskill_cmd_is_done, &status);
 
-	if (rc == -EAGAIN) {
+	if (rc == -ETIMEDOUT) {
 		log_error(device->ratbag,
-			  "Failed to get command response from mouse after %d tries, giving up\n",
-			  retries);
-		rc = -ETIMEDOUT;
+			  "Failed to get command response from mouse after %dms, giving up\n",
+			  GSKILL_CMD_TIMEOUT_MS);
 	} else if (rc) {
 		log_error(device->ratbag,
 			  "Failed to perform command on mouse: %d\n",
@@ -815,7 +830,7 @@ gskill_macro_to_report(struct ratbag_device *device,
 		&drv_data->profile_data[profile].macros[button];
 	struct gskill_macro_delay *delay;
 	unsigned int event_num = ratbag_button_macro_get_num_events(macro);
-	struct ratbag_macro_event *event;
+	struct ratbag_macro_event event;
 	uint8_t *buf = report->macro_content;
 	int profile_pos, increment, event_idx;
 	ssize_t ret;
@@ -849,20 +864,20 @@ gskill_macro_to_report(struct ratbag_device *device,
 	for (profile_pos = 0, increment = 1, event_idx = 0;
 	     event_idx < (signed)event_num;
 	     event_idx++, profile_pos += increment, increment = 1) {
-		event = &macro->macro.events[event_idx];
+		event = ratbag_macro_get_event(&macro->macro, event_idx);
 
-		switch (event->type) {
+		switch (event.type) {
 		case RATBAG_MACRO_EVENT_WAIT:
 			delay = (struct gskill_macro_delay*)&buf[profile_pos];
 			increment = sizeof(*delay);
 
 			delay->tag = 1;
-			delay->count = event->event.timeout;
+			delay->count = event.event.timeout;
 			break;
 		case RATBAG_MACRO_EVENT_KEY_PRESSED:
 		case RATBAG_MACRO_EVENT_KEY_RELEASED:
 			buf[profile_pos] = gskill_macro_code_from_event(device,
-									event);
+									&event);
 			break;
 		case RATBAG_MACRO_EVENT_INVALID:
 		case RATBAG_MACRO_EVENT_NONE:
@@ -37,11 +37,14 @@
 
 #include <linux/types.h>
 #include <errno.h>
+#include <glib.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "hidpp20.h"
+#include "hidpp20-cache.h"
 
 #include "libratbag-private.h"
 #include "libratbag-hidraw.h"
@@ -79,6 +82,11 @@ struct hidpp20drv_data {
 	unsigned int num_resolutions;
 	unsigned int num_buttons;
 	unsigned int num_leds;
+
+	char *cache_path;
+	char *cache_firmware;
+	GKeyFile *cache;	/* only set during probe */
+	bool cache_stale;	/* probe read something the cache lacks */
 };
 
 static void
@@ -1277,11 +1285,148 @@ hidpp20drv_init_leds_8070_8071(struct ratbag_device *device)
 	return 0;
 }
 
+/* -------------------------------------------------------------------------- */
+/* probe cache                                                                */
+/* -------------------------------------------------------------------------- */
+
+static void
+hidpp20drv_cache_init(struct ratbag_device *device)
+{
+	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
+	struct hidpp20_device_info info;
+	GString *firmware;
+	unsigned int i;
+	int rc;
+
+	rc = hidpp20_device_info_get_device_info(drv_data->dev, &info);
+	if (rc) {
+		log_debug(device->ratbag, "hidpp20: no device info, probe cache disabled\n");
+		return;
+	}
+
+	/* entity_count comes from the device, the string has to grow */
+	firmware = g_string_new(NULL);
+	for (i = 0; i < info.entity_count; i++) {
+		struct hidpp20_fw_info fw;
+
+		rc = hidpp20_device_info_get_fw_info(drv_data->dev, i, &fw);
+		if (rc) {
+			g_string_free(firmware, TRUE);
+			return;
+		}
+
+		g_string_append_printf(firmware, "%s%u:%s:%02x.%02x.%04x",
+				       i ? ";" : "", fw.type, fw.prefix,
+				       fw.number, fw.revision, fw.build);
+	}
+
+	rc = xasprintf(&drv_data->cache_path,
+		       "%s/hidpp20-%04x-%04x-%04x-%02x%02x%02x%02x.cache",
+		       hidpp20_cache_get_dir(),
+		       device->ids.bustype,
+		       device->ids.vendor,
+		       device->ids.product,
+		       info.unit_id[0], info.unit_id[1],
+		       info.unit_id[2], info.unit_id[3]);
+	if (rc == -1) {
+		drv_data->cache_path = NULL;
+		g_string_free(firmware, TRUE);
+		return;
+	}
+
+	drv_data->cache_firmware = g_string_free(firmware, FALSE);
+}
+
+/**
+ * Loads the cache file of the device. Returns NULL if there is no cache
+ * file or if it is for another version of the cache or firmware.
+ */
+static GKeyFile *
+hidpp20drv_cache_load(struct ratbag_device *device)
+{
+	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
+
+	if (!drv_data->cache_path)
+		return NULL;
+
+	return hidpp20_cache_load(device->ratbag, drv_data->cache_path,
+				  drv_data->cache_firmware);
+}
+
+static int
+hidpp20drv_cache_restore_features(struct ratbag_device *device,
+				  GKeyFile *keyfile)
+{
+	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
+	_cleanup_free_ struct hidpp20_feature *features = NULL;
+	unsigned int count;
+	int rc;
+
+	rc = hidpp20_cache_get_features(keyfile, &features, &count);
+	if (rc)
+		return rc;
+
+	hidpp20_device_set_features(drv_data->dev, features, count);
+
+	return 0;
+}
+
+static unsigned int
+hidpp20drv_cache_count_sectors(struct hidpp20_profiles *profiles)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i <= profiles->num_profiles; i++) {
+		if (profiles->shadow_valid[i])
+			count++;
+	}
+
+	return count;
+}
+
+/**
+ * Restores the shadow sectors from the cache. Returns the number of
+ * sectors still valid after checking them against the device.
+ */
+static unsigned int
+hidpp20drv_cache_restore_profiles(struct ratbag_device *device,
+				  GKeyFile *keyfile)
+{
+	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
+	int rc;
+
+	hidpp20_cache_get_sectors(keyfile, drv_data->profiles);
+
+	rc = hidpp20_onboard_profiles_verify_shadow(drv_data->dev, drv_data->profiles);
+	if (rc)
+		log_debug(device->ratbag, "hidpp20: cached profiles are outdated (%d)\n", rc);
+
+	return hidpp20drv_cache_count_sectors(drv_data->profiles);
+}
+
+static void
+hidpp20drv_cache_save(struct ratbag_device *device)
+{
+	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
+	struct hidpp20_device *dev = drv_data->dev;
+
+	if (!drv_data->cache_path || dev->feature_count == 0)
+		return;
+
+	(void) hidpp20_cache_save(device->ratbag,
+				  drv_data->cache_path,
+				  drv_data->cache_firmware,
+				  dev->feature_list,
+				  dev->feature_count,
+				  drv_data->profiles);
+}
+
 static int
 hidpp20drv_init_profile_8100(struct ratbag_device *device)
 {
 	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
 	struct ratbag *ratbag = device->ratbag;
+	unsigned int restored = 0;
 	int rc;
 
 	log_debug(ratbag, "initializing onboard profiles\n");
@@ -1289,10 +1434,18 @@ hidpp20drv_init_profile_8100(struct ratbag_device *device)
 	if (rc < 0)
 		return rc;
 
+	if (drv_data->cache)
+		restored = hidpp20drv_cache_restore_profiles(device, drv_data->cache);
+
 	rc = hidpp20_onboard_profiles_initialize(drv_data->dev, drv_data->profiles);
 	if (rc < 0)
 		return rc;
 
+	/* sectors are only ever added to the shadow here, a different
+	 * count means some were read from the device */
+	if (hidpp20drv_cache_count_sectors(drv_data->profiles) != restored)
+		drv_data->cache_stale = true;
+
 	drv_data->num_profiles = drv_data->profiles->num_profiles;
 	drv_data->num_buttons = drv_data->profiles->num_buttons;
 
@@ -1336,13 +1489,14 @@ hidpp20drv_init_feature(struct ratbag_device *device, uint16_t feature)
 	struct hidpp20drv_data *drv_data = ratbag_get_drv_data(device);
 	struct ratbag *ratbag = device->ratbag;
 	int rc;
-	uint8_t feature_index, feature_type, feature_version;
-
-	rc = hidpp_root_get_feature(drv_data->dev,
-				    feature,
-				    &feature_index,
-				    &feature_type,
-				    &feature_version);
+	uint8_t feature_type;
+
+	/* the feature list is already known, no need to ask the device */
+	rc = hidpp20_device_get_feature(drv_data->dev,
+					feature,
+					NULL,
+					&feature_type,
+					NULL);
 	if (rc < 0)
 		return rc;
 
@@ -1534,6 +1688,8 @@ hidpp20drv_commit(struct ratbag_device *device)
 
 		rc = hidpp20_onboard_profiles_commit(drv_data->dev,
 						     drv_data->profiles);
+		/* the shadow copies changed even if the commit failed */
+		hidpp20drv_cache_save(device);
 		if (rc) {
 			log_error(device->ratbag, "hidpp20: failed to commit profile (%d)\n", rc);
 			return RATBAG_ERROR_DEVICE;
@@ -1627,6 +1783,10 @@ hidpp20drv_remove(struct ratbag_device *device)
 	free(drv_data->leds);
 	if (drv_data->dev)
 		hidpp20_device_destroy(drv_data->dev);
+	if (drv_data->cache)
+		g_key_file_free(drv_data->cache);
+	free(drv_data->cache_path);
+	free(drv_data->cache_firmware);
 	free(drv_data);
 }
 
@@ -1694,7 +1854,7 @@ hidpp20drv_probe(struct ratbag_device *device)
 	 * If there is a special need like for G900, we can add this in the
 	 * device data file.
 	 */
-	dev = hidpp20_device_new(&base, device_idx, (struct hidpp_hid_report*) device->hidraw[0].reports, device->hidraw[0].num_reports);
+	dev = hidpp20_device_new_uninitialized(&base, device_idx, (struct hidpp_hid_report*) device->hidraw[0].reports, device->hidraw[0].num_reports);
 	if (!dev) {
 		rc = -ENODEV;
 		goto err;
@@ -1704,6 +1864,18 @@ hidpp20drv_probe(struct ratbag_device *device)
 
 	drv_data->dev = dev;
 
+	hidpp20drv_cache_init(device);
+	drv_data->cache = hidpp20drv_cache_load(device);
+	if (!drv_data->cache ||
+	    hidpp20drv_cache_restore_features(device, drv_data->cache)) {
+		drv_data->cache_stale = true;
+		rc = hidpp20_device_init_features(dev);
+		if (rc < 0) {
+			rc = -ENODEV;
+			goto err;
+		}
+	}
+
 	log_debug(device->ratbag, "'%s' is using protocol v%d.%d\n", ratbag_device_get_name(device), dev->proto_major, dev->proto_minor);
 
 	if(dev->quirk != HIDPP20_QUIRK_NONE)
@@ -1719,6 +1891,14 @@ hidpp20drv_probe(struct ratbag_device *device)
 	if (rc)
 		goto err;
 
+	if (drv_data->cache) {
+		g_key_file_free(drv_data->cache);
+		drv_data->cache = NULL;
+	}
+	/* a valid cache that provided everything is left alone */
+	if (drv_data->cache_stale)
+		hidpp20drv_cache_save(device);
+
 	hidpp20drv_init_device(device, drv_data);
 
 	return rc;
@@ -75,10 +75,13 @@ struct logitech_g300_profile_report {
 
 struct logitech_g300_profile_data {
 	struct logitech_g300_profile_report report;
+	/* what the device has, to skip writing unchanged reports */
+	struct logitech_g300_profile_report written;
 };
 
 struct logitech_g300_data {
 	struct logitech_g300_profile_data profile_data[LOGITECH_G300_PROFILE_MAX + 1];
+	int active_resolution; /* -1 if unknown */
 };
 
 _Static_assert(sizeof(struct logitech_g300_profile_report) == LOGITECH_G300_REPORT_SIZE_PROFILE,
@@ -263,6 +266,7 @@ struct logitech_g300_F0_report {
 static int
 logitech_g300_get_active_profile_and_resolution(struct ratbag_device *device)
 {
+	struct logitech_g300_data *drv_data = device->drv_data;
 	struct ratbag_profile *profile;
 	struct logitech_g300_F0_report buf;
 	int ret;
@@ -288,12 +292,15 @@ logitech_g300_get_active_profile_and_resolution(struct ratbag_device *device)
 		}
 	}
 
+	drv_data->active_resolution = buf.resolution;
+
 	return 0;
 }
 
 static int
 logitech_g300_set_active_profile(struct ratbag_device *device, unsigned int index)
 {
+	struct logitech_g300_data *drv_data = device->drv_data;
 	struct ratbag_profile *profile;
 	uint8_t buf[] = {LOGITECH_G300_REPORT_ID_SET_ACTIVE, 0x80 | (index << 4), 0x00, 0x00};
 	int ret;
@@ -316,6 +323,9 @@ logitech_g300_set_active_profile(struct ratbag_device *device, unsigned int inde
 
 		ratbag_profile_for_each_resolution(profile, resolution) {
 			resolution->is_active = resolution->is_default;
+
+			if (resolution->is_active)
+				drv_data->active_resolution = resolution->index;
 		}
 	}
 
@@ -325,6 +335,7 @@ logitech_g300_set_active_profile(struct ratbag_device *device, unsigned int inde
 static int
 logitech_g300_set_current_resolution(struct ratbag_device *device, unsigned int index)
 {
+	struct logitech_g300_data *drv_data = device->drv_data;
 	uint8_t buf[] = {LOGITECH_G300_REPORT_ID_SET_ACTIVE, 0x40 | (index << 1), 0x00, 0x00};
 	int ret;
 
@@ -333,8 +344,14 @@ logitech_g300_set_current_resolution(struct ratbag_device *device, unsigned int
 
 	ret = ratbag_hidraw_raw_request(device, buf[0], buf, sizeof(buf),
 			HID_FEATURE_REPORT, HID_REQ_SET_REPORT);
+	if (ret != sizeof(buf)) {
+		drv_data->active_resolution = -1;
+		return ret;
+	}
+
+	drv_data->active_resolution = index;
 
-	return ret == sizeof(buf) ? 0 : ret;
+	return 0;
 }
 
 static void
@@ -441,6 +458,8 @@ logitech_g300_read_profile(struct ratbag_profile *profile)
 		return;
 	}
 
+	pdata->written = *report;
+
 	hz = logitech_g300_raw_to_frequency(report->frequency);
 
 	ratbag_profile_set_report_rate_list(profile, &hz, 1);
@@ -487,6 +506,7 @@ logitech_g300_probe(struct ratbag_device *device)
 		goto err;
 
 	drv_data = zalloc(sizeof(*drv_data));
+	drv_data->active_resolution = -1;
 	ratbag_set_drv_data(device, drv_data);
 
 	/* profiles are 0-indexed */
@@ -535,7 +555,8 @@ logitech_g300_write_profile(struct ratbag_profile *profile)
 	struct ratbag_led *led;
 
 	uint8_t *buf;
-	int rc;
+	int rc, active_resolution = -1;
+	bool written = false;
 
 	pdata = &drv_data->profile_data[profile->index];
 	report = &pdata->report;
@@ -550,8 +571,7 @@ logitech_g300_write_profile(struct ratbag_profile *profile)
 		res->is_default = resolution->is_default;
 
 		if (profile->is_active && resolution->is_active)
-			logitech_g300_set_current_resolution(device,
-							     resolution->index);
+			active_resolution = resolution->index;
 	}
 
 	list_for_each(button, &profile->buttons, link) {
@@ -598,18 +618,30 @@ logitech_g300_write_profile(struct ratbag_profile *profile)
 
 	buf = (uint8_t*)report;
 
-	rc = ratbag_hidraw_raw_request(device, report->id,
-				       buf,
-				       sizeof(*report),
-				       HID_FEATURE_REPORT,
-				       HID_REQ_SET_REPORT);
+	/* changing only the active resolution doesn't touch the report */
+	if (memcmp(report, &pdata->written, sizeof(*report)) != 0) {
+		rc = ratbag_hidraw_raw_request(device, report->id,
+					       buf,
+					       sizeof(*report),
+					       HID_FEATURE_REPORT,
+					       HID_REQ_SET_REPORT);
 
-	if (rc < (int)sizeof(*report)) {
-		log_error(device->ratbag,
-			  "Error while writing profile: %d\n", rc);
-		return rc;
+		if (rc < (int)sizeof(*report)) {
+			log_error(device->ratbag,
+				  "Error while writing profile: %d\n", rc);
+			return rc;
+		}
+
+		pdata->written = *report;
+		written = true;
 	}
 
+	/* a profile write may reset the active resolution, so set it
+	 * again after one */
+	if (active_resolution >= 0 &&
+	    (written || active_resolution != drv_data->active_resolution))
+		logitech_g300_set_current_resolution(device, active_resolution);
+
 	return 0;
 }
 
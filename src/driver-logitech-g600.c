@@ -88,10 +88,13 @@ struct logitech_g600_active_profile_report {
 
 struct logitech_g600_profile_data {
 	struct logitech_g600_profile_report report;
+	/* what the device has, to skip writing unchanged reports */
+	struct logitech_g600_profile_report written;
 };
 
 struct logitech_g600_data {
 	struct logitech_g600_profile_data profile_data[LOGITECH_G600_NUM_PROFILES];
+	int active_resolution; /* -1 if unknown */
 };
 
 _Static_assert(sizeof(struct logitech_g600_profile_report) == LOGITECH_G600_REPORT_SIZE_PROFILE,
@@ -235,6 +238,7 @@ logitech_g600_button_action_to_raw(const struct ratbag_button_action *action)
 static int
 logitech_g600_get_active_profile_and_resolution(struct ratbag_device *device)
 {
+	struct logitech_g600_data *drv_data = device->drv_data;
 	struct ratbag_profile *profile;
 	struct logitech_g600_active_profile_report buf;
 	int ret;
@@ -261,12 +265,15 @@ logitech_g600_get_active_profile_and_resolution(struct ratbag_device *device)
 		}
 	}
 
+	drv_data->active_resolution = buf.resolution;
+
 	return 0;
 }
 
 static int
 logitech_g600_set_current_resolution(struct ratbag_device *device, unsigned int index)
 {
+	struct logitech_g600_data *drv_data = device->drv_data;
 	uint8_t buf[] = {LOGITECH_G600_REPORT_ID_SET_ACTIVE, 0x40 | (index << 1), 0x00, 0x00};
 	int ret;
 
@@ -277,8 +284,14 @@ logitech_g600_set_current_resolution(struct ratbag_device *device, unsigned int
 
 	ret = ratbag_hidraw_raw_request(device, buf[0], buf, sizeof(buf),
 			HID_FEATURE_REPORT, HID_REQ_SET_REPORT);
+	if (ret != sizeof(buf)) {
+		drv_data->active_resolution = -1;
+		return ret;
+	}
+
+	drv_data->active_resolution = index;
 
-	return ret == sizeof(buf) ? 0 : ret;
+	return 0;
 }
 
 static int
@@ -402,7 +415,7 @@ logitech_g600_read_led(struct ratbag_led *led)
 }
 
 static void
-logitech_g600_read_profile(struct ratbag_profile *profile)
+logitech_g600_read_profile(struct ratbag_profile *profile, int rc)
 {
 	struct ratbag_device *device = profile->device;
 	struct logitech_g600_data *drv_data = device->drv_data;
@@ -410,8 +423,6 @@ logitech_g600_read_profile(struct ratbag_profile *profile)
 	struct logitech_g600_profile_report *report;
 	struct ratbag_resolution *resolution;
 	unsigned int report_rates[] = { 125, 142, 166, 200, 250, 333, 500, 1000 };
-	uint8_t report_id;
-	int rc;
 	struct ratbag_button *button;
 	struct ratbag_led *led;
 
@@ -420,24 +431,14 @@ logitech_g600_read_profile(struct ratbag_profile *profile)
 	pdata = &drv_data->profile_data[profile->index];
 	report = &pdata->report;
 
-	switch (profile->index) {
-	case 0: report_id = LOGITECH_G600_REPORT_ID_PROFILE_0; break;
-	case 1: report_id = LOGITECH_G600_REPORT_ID_PROFILE_1; break;
-	case 2: report_id = LOGITECH_G600_REPORT_ID_PROFILE_2; break;
-	}
-
-	rc = ratbag_hidraw_raw_request(device, report_id,
-					       (uint8_t*)report,
-					       sizeof(*report),
-					       HID_FEATURE_REPORT,
-					       HID_REQ_GET_REPORT);
-
 	if (rc < (int)sizeof(*report)) {
 		log_error(device->ratbag,
 			  "Error while requesting profile: %d\n", rc);
 		return;
 	}
 
+	pdata->written = *report;
+
 	ratbag_profile_set_report_rate_list(profile, report_rates,
 					    ARRAY_LENGTH(report_rates));
 	ratbag_profile_set_report_rate(profile, 1000 / (report->frequency + 1));
@@ -466,6 +467,30 @@ logitech_g600_read_profile(struct ratbag_profile *profile)
 		      report->unknown2, 13);
 }
 
+/* fetches the reports of all profiles in one go, the result of each
+ * is in its request's rc */
+static void
+logitech_g600_read_profile_reports(struct ratbag_device *device,
+				   struct ratbag_hidraw_feature_request *requests)
+{
+	struct logitech_g600_data *drv_data = device->drv_data;
+	static const uint8_t report_ids[LOGITECH_G600_NUM_PROFILES] = {
+		LOGITECH_G600_REPORT_ID_PROFILE_0,
+		LOGITECH_G600_REPORT_ID_PROFILE_1,
+		LOGITECH_G600_REPORT_ID_PROFILE_2,
+	};
+	unsigned int i;
+
+	for (i = 0; i < LOGITECH_G600_NUM_PROFILES; i++) {
+		requests[i].reportnum = report_ids[i];
+		requests[i].buf = (uint8_t*)&drv_data->profile_data[i].report;
+		requests[i].len = sizeof(drv_data->profile_data[i].report);
+	}
+
+	ratbag_hidraw_get_feature_reports(device, requests,
+					  LOGITECH_G600_NUM_PROFILES);
+}
+
 static int
 logitech_g600_test_hidraw(struct ratbag_device *device)
 {
@@ -478,12 +503,14 @@ logitech_g600_probe(struct ratbag_device *device)
 	int rc;
 	struct logitech_g600_data *drv_data = NULL;
 	struct ratbag_profile *profile;
+	struct ratbag_hidraw_feature_request requests[LOGITECH_G600_NUM_PROFILES] = {0};
 
 	rc = ratbag_find_hidraw(device, logitech_g600_test_hidraw);
 	if (rc)
 		goto err;
 
 	drv_data = zalloc(sizeof(*drv_data));
+	drv_data->active_resolution = -1;
 	ratbag_set_drv_data(device, drv_data);
 
 	ratbag_device_init_profiles(device,
@@ -492,8 +519,9 @@ logitech_g600_probe(struct ratbag_device *device)
 				    LOGITECH_G600_NUM_BUTTONS,
 				    LOGITECH_G600_NUM_LED);
 
+	logitech_g600_read_profile_reports(device, requests);
 	ratbag_device_for_each_profile(device, profile)
-		logitech_g600_read_profile(profile);
+		logitech_g600_read_profile(profile, requests[profile->index].rc);
 
 	rc = logitech_g600_get_active_profile_and_resolution(device);
 
@@ -527,6 +555,7 @@ logitech_g600_write_profile(struct ratbag_profile *profile)
 
 	uint8_t *buf;
 	int rc, active_resolution = 0;
+	bool written = false;
 
 	pdata = &drv_data->profile_data[profile->index];
 	report = &pdata->report;
@@ -602,19 +631,28 @@ logitech_g600_write_profile(struct ratbag_profile *profile)
 
 	buf = (uint8_t*)report;
 
-	rc = ratbag_hidraw_raw_request(device, report->id,
-				       buf,
-				       sizeof(*report),
-				       HID_FEATURE_REPORT,
-				       HID_REQ_SET_REPORT);
+	/* changing only the active resolution doesn't touch the report */
+	if (memcmp(report, &pdata->written, sizeof(*report)) != 0) {
+		rc = ratbag_hidraw_raw_request(device, report->id,
+					       buf,
+					       sizeof(*report),
+					       HID_FEATURE_REPORT,
+					       HID_REQ_SET_REPORT);
+
+		if (rc < (int)sizeof(*report)) {
+			log_error(device->ratbag,
+				  "Error while writing profile: %d\n", rc);
+			return rc;
+		}
 
-	if (rc < (int)sizeof(*report)) {
-		log_error(device->ratbag,
-			  "Error while writing profile: %d\n", rc);
-		return rc;
+		pdata->written = *report;
+		written = true;
 	}
 
-	if (profile->is_active) {
+	/* a profile write may reset the active resolution, so set it
+	 * again after one */
+	if (profile->is_active &&
+	    (written || active_resolution != drv_data->active_resolution)) {
 		rc = logitech_g600_set_current_resolution(device, active_resolution);
 		if (rc < 0)
 			return rc;
@@ -38,7 +38,7 @@
 #define ROCCAT_NUM_DPI				5
 #define ROCCAT_LED_MAX				0
 
-#define ROCCAT_MAX_RETRY_READY			10
+#define ROCCAT_READY_TIMEOUT_MS			1100
 
 #define ROCCAT_REPORT_ID_CONFIGURE_PROFILE	4
 #define ROCCAT_REPORT_ID_PROFILE		5
@@ -98,9 +98,39 @@ struct roccat_macro {
 struct roccat_data {
 	uint8_t profiles[(ROCCAT_PROFILE_MAX + 1)][ROCCAT_REPORT_SIZE_PROFILE];
 	struct roccat_settings_report settings[(ROCCAT_PROFILE_MAX + 1)];
-	struct roccat_macro macros[(ROCCAT_PROFILE_MAX + 1)][(ROCCAT_BUTTON_MAX + 1)];
+	struct ratbag_poll_latency ready_latency;
+	/* only allocated for the buttons that have a macro */
+	struct roccat_macro *macros[(ROCCAT_PROFILE_MAX + 1)][(ROCCAT_BUTTON_MAX + 1)];
 };
 
+static struct roccat_macro *
+roccat_get_macro(struct roccat_data *drv_data, struct ratbag_button *button)
+{
+	struct roccat_macro **slot;
+
+	slot = &drv_data->macros[button->profile->index][button->index];
+	if (!*slot)
+		*slot = zalloc(sizeof(**slot));
+
+	return *slot;
+}
+
+static void
+roccat_free_data(struct roccat_data *drv_data)
+{
+	unsigned int i, j;
+
+	if (!drv_data)
+		return;
+
+	for (i = 0; i <= ROCCAT_PROFILE_MAX; i++) {
+		for (j = 0; j <= ROCCAT_BUTTON_MAX; j++)
+			free(drv_data->macros[i][j]);
+	}
+
+	free(drv_data);
+}
+
 struct roccat_button_type_mapping {
 	uint8_t raw;
 	enum ratbag_button_type type;
@@ -262,8 +292,9 @@ roccat_crc_is_valid(struct ratbag_device *device, uint8_t *buf, unsigned int len
 }
 
 static int
-roccat_is_ready(struct ratbag_device *device)
+roccat_is_ready(void *data)
 {
+	struct ratbag_device *device = data;
 	uint8_t buf[3] = { 0 };
 	int rc;
 
@@ -274,38 +305,26 @@ roccat_is_ready(struct ratbag_device *device)
 	if (rc != sizeof(buf))
 		return -EIO;
 
-	if (buf[1] == 0x03)
-		msleep(100);
-
-	if (buf[1] == 0x02)
+	switch (buf[1]) {
+	case 0x01:
+		return 0;
+	case 0x02:
 		return 2;
-
-	return buf[1] == 0x01;
+	default:
+		/* 0x03 is busy for a while longer, the backoff in
+		 * ratbag_poll_ready() takes care of that */
+		return -EAGAIN;
+	}
 }
 
 static int
 roccat_wait_ready(struct ratbag_device *device)
 {
-	unsigned count = 0;
-	int rc;
-
-	msleep(10);
-	while (count < ROCCAT_MAX_RETRY_READY) {
-		rc = roccat_is_ready(device);
-		if (rc < 0)
-			return rc;
-
-		if (rc == 1)
-			return 0;
-
-		if (rc == 2)
-			return 2;
-
-		msleep(10);
-		count++;
-	}
+	struct roccat_data *drv_data = ratbag_get_drv_data(device);
 
-	return -ETIMEDOUT;
+	return ratbag_poll_ready(drv_data ? &drv_data->ready_latency : NULL,
+				 0, ROCCAT_READY_TIMEOUT_MS,
+				 roccat_is_ready, device);
 }
 
 static int
@@ -427,19 +446,105 @@ roccat_write_profile(struct ratbag_profile *profile)
 	return rc;
 }
 
-static void
-roccat_read_button(struct ratbag_button *button)
+static int
+roccat_read_macro(struct ratbag_button *button)
 {
-	const struct ratbag_button_action *action;
 	struct ratbag_device *device;
-	struct roccat_macro *macro;
+	struct roccat_macro **slot;
 	struct roccat_data *drv_data;
+	_cleanup_free_ struct roccat_macro *macro = NULL;
+	struct ratbag_button_macro *m = NULL;
 	uint8_t *buf;
 	unsigned j, time;
 	int rc;
 
 	device = button->profile->device;
 	drv_data = ratbag_get_drv_data(device);
+
+	roccat_set_config_profile(device,
+				  button->profile->index,
+				  0);
+	roccat_set_config_profile(device,
+				  button->profile->index,
+				  button->index);
+	/* read into a separate buffer, the slot is only filled once the
+	 * macro turns out valid */
+	macro = zalloc(sizeof(*macro));
+	buf = (uint8_t*)macro;
+	buf[0] = ROCCAT_REPORT_ID_MACRO;
+	rc = ratbag_hidraw_get_feature_report(device, ROCCAT_REPORT_ID_MACRO,
+					      buf, ROCCAT_REPORT_SIZE_MACRO);
+	if (rc != ROCCAT_REPORT_SIZE_MACRO) {
+		log_error(device->ratbag,
+			  "Unable to retrieve the macro for button %d of profile %d: %s (%d)\n",
+			  button->index, button->profile->index,
+			  rc < 0 ? strerror(-rc) : "not read enough", rc);
+		rc = rc < 0 ? rc : -EIO;
+		goto out_macro;
+	}
+
+	rc = -EIO;
+	if (buf[0] != ROCCAT_REPORT_ID_MACRO) {
+		log_error(device->ratbag,
+			  "Error while reading the macro of button %d of profile %d.\n",
+			  button->index,
+			  button->profile->index);
+		goto out_macro;
+	}
+	if (!roccat_crc_is_valid(device, buf, ROCCAT_REPORT_SIZE_MACRO)) {
+		log_error(device->ratbag,
+			  "wrong checksum while reading the macro of button %d of profile %d.\n",
+			  button->index,
+			  button->profile->index);
+		goto out_macro;
+	}
+
+	m = ratbag_button_macro_new(macro->name);
+	log_raw(device->ratbag,
+		"macro on button %d of profile %d is named '%s', and contains %d events:\n",
+		button->index, button->profile->index,
+		macro->name, macro->length);
+	for (j = 0; j < macro->length; j++) {
+		unsigned int keycode = ratbag_hidraw_get_keycode_from_keyboard_usage(device,
+						macro->keys[j].keycode);
+		ratbag_button_macro_set_event(m,
+					      j * 2,
+					      macro->keys[j].flag & 0x01 ? RATBAG_MACRO_EVENT_KEY_PRESSED : RATBAG_MACRO_EVENT_KEY_RELEASED,
+					      keycode);
+		if (macro->keys[j].time)
+			time = macro->keys[j].time;
+		else
+			time = macro->keys[j].flag & 0x01 ? 10 : 50;
+		ratbag_button_macro_set_event(m,
+					      j * 2 + 1,
+					      RATBAG_MACRO_EVENT_WAIT,
+					      time);
+
+		log_raw(device->ratbag,
+			"    - %s %s\n",
+			libevdev_event_code_get_name(EV_KEY, keycode),
+			macro->keys[j].flag & 0x80 ? "released" : "pressed");
+	}
+	ratbag_button_copy_macro(button, m);
+
+	slot = &drv_data->macros[button->profile->index][button->index];
+	free(*slot);
+	*slot = macro;
+	macro = NULL;
+	rc = 0;
+
+out_macro:
+	msleep(10);
+	ratbag_button_macro_unref(m);
+
+	return rc;
+}
+
+static void
+roccat_read_button(struct ratbag_button *button)
+{
+	const struct ratbag_button_action *action;
+
 	action = roccat_button_to_action(button->profile, button->index);
 	if (action)
 		ratbag_button_set_action(button, action);
@@ -454,73 +559,10 @@ roccat_read_button(struct ratbag_button *button)
 	ratbag_button_enable_action_type(button, RATBAG_BUTTON_ACTION_TYPE_SPECIAL);
 	ratbag_button_enable_action_type(button, RATBAG_BUTTON_ACTION_TYPE_MACRO);
 
-	if (action && action->type == RATBAG_BUTTON_ACTION_TYPE_MACRO) {
-		struct ratbag_button_macro *m = NULL;
-
-		roccat_set_config_profile(device,
-					  button->profile->index,
-					  0);
-		roccat_set_config_profile(device,
-					  button->profile->index,
-					  button->index);
-		macro = &drv_data->macros[button->profile->index][button->index];
-		buf = (uint8_t*)macro;
-		buf[0] = ROCCAT_REPORT_ID_MACRO;
-		rc = ratbag_hidraw_get_feature_report(device, ROCCAT_REPORT_ID_MACRO,
-						      buf, ROCCAT_REPORT_SIZE_MACRO);
-		if (rc != ROCCAT_REPORT_SIZE_MACRO) {
-			log_error(device->ratbag,
-				  "Unable to retrieve the macro for button %d of profile %d: %s (%d)\n",
-				  button->index, button->profile->index,
-				  rc < 0 ? strerror(-rc) : "not read enough", rc);
-		} else {
-			if (buf[0] != ROCCAT_REPORT_ID_MACRO) {
-				log_error(device->ratbag,
-					  "Error while reading the macro of button %d of profile %d.\n",
-					  button->index,
-					  button->profile->index);
-				goto out_macro;
-			}
-			if (!roccat_crc_is_valid(device, buf, ROCCAT_REPORT_SIZE_MACRO)) {
-				log_error(device->ratbag,
-					  "wrong checksum while reading the macro of button %d of profile %d.\n",
-					  button->index,
-					  button->profile->index);
-				goto out_macro;
-			}
-
-			m = ratbag_button_macro_new(macro->name);
-			log_raw(device->ratbag,
-				"macro on button %d of profile %d is named '%s', and contains %d events:\n",
-				button->index, button->profile->index,
-				macro->name, macro->length);
-			for (j = 0; j < macro->length; j++) {
-				unsigned int keycode = ratbag_hidraw_get_keycode_from_keyboard_usage(device,
-								macro->keys[j].keycode);
-				ratbag_button_macro_set_event(m,
-							      j * 2,
-							      macro->keys[j].flag & 0x01 ? RATBAG_MACRO_EVENT_KEY_PRESSED : RATBAG_MACRO_EVENT_KEY_RELEASED,
-							      keycode);
-				if (macro->keys[j].time)
-					time = macro->keys[j].time;
-				else
-					time = macro->keys[j].flag & 0x01 ? 10 : 50;
-				ratbag_button_macro_set_event(m,
-							      j * 2 + 1,
-							      RATBAG_MACRO_EVENT_WAIT,
-							      time);
-
-				log_raw(device->ratbag,
-					"    - %s %s\n",
-					libevdev_event_code_get_name(EV_KEY, keycode),
-					macro->keys[j].flag & 0x80 ? "released" : "pressed");
-			}
-			ratbag_button_copy_macro(button, m);
-		}
-out_macro:
-		msleep(10);
-		ratbag_button_macro_unref(m);
-	}
+	/* every macro is a separate 2k report, only read it once someone
+	 * asks for it, see roccat_read_macro() */
+	if (action && action->type == RATBAG_BUTTON_ACTION_TYPE_MACRO)
+		button->macro_pending = true;
 }
 
 static int
@@ -539,29 +581,31 @@ roccat_write_macro(struct ratbag_button *button,
 
 	device = button->profile->device;
 	drv_data = ratbag_get_drv_data(device);
-	macro = &drv_data->macros[button->profile->index][button->index];
+	macro = roccat_get_macro(drv_data, button);
 	buf = (uint8_t*)macro;
 
 	memset(buf, 0, ROCCAT_REPORT_SIZE_MACRO);
 
-	for (i = 0; i < MAX_MACRO_EVENTS && count < ROCCAT_MAX_MACRO_LENGTH; i++) {
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_INVALID)
+	for (i = 0; i < ratbag_macro_get_num_events(action->macro) && count < ROCCAT_MAX_MACRO_LENGTH; i++) {
+		struct ratbag_macro_event event = ratbag_macro_get_event(action->macro, i);
+
+		if (event.type == RATBAG_MACRO_EVENT_INVALID)
 			return -EINVAL; /* should not happen, ever */
 
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_NONE)
+		if (event.type == RATBAG_MACRO_EVENT_NONE)
 			break;
 
 		/* ignore the first wait */
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_WAIT &&
+		if (event.type == RATBAG_MACRO_EVENT_WAIT &&
 		    !count)
 			continue;
 
-		if (action->macro->events[i].type == RATBAG_MACRO_EVENT_KEY_PRESSED ||
-		    action->macro->events[i].type == RATBAG_MACRO_EVENT_KEY_RELEASED) {
-			macro->keys[count].keycode = ratbag_hidraw_get_keyboard_usage_from_keycode(device, action->macro->events[i].event.key);
+		if (event.type == RATBAG_MACRO_EVENT_KEY_PRESSED ||
+		    event.type == RATBAG_MACRO_EVENT_KEY_RELEASED) {
+			macro->keys[count].keycode = ratbag_hidraw_get_keyboard_usage_from_keycode(device, event.event.key);
 		}
 
-		switch (action->macro->events[i].type) {
+		switch (event.type) {
 		case RATBAG_MACRO_EVENT_KEY_PRESSED:
 			macro->keys[count].flag = 0x01;
 			break;
@@ -569,7 +613,7 @@ roccat_write_macro(struct ratbag_button *button,
 			macro->keys[count].flag = 0x02;
 			break;
 		case RATBAG_MACRO_EVENT_WAIT:
-			macro->keys[--count].time = action->macro->events[i].event.timeout;
+			macro->keys[--count].time = event.event.timeout;
 			break;
 		case RATBAG_MACRO_EVENT_INVALID:
 		case RATBAG_MACRO_EVENT_NONE:
@@ -823,7 +867,7 @@ roccat_probe(struct ratbag_device *device)
 	return 0;
 
 err:
-	free(drv_data);
+	roccat_free_data(drv_data);
 	ratbag_set_drv_data(device, NULL);
 	return rc;
 }
@@ -832,7 +876,7 @@ static void
 roccat_remove(struct ratbag_device *device)
 {
 	ratbag_close_hidraw(device);
-	free(ratbag_get_drv_data(device));
+	roccat_free_data(ratbag_get_drv_data(device));
 }
 
 struct ratbag_driver roccat_driver = {
@@ -842,6 +886,7 @@ struct ratbag_driver roccat_driver = {
 	.remove = roccat_remove,
 	.write_profile = roccat_write_profile,
 	.set_active_profile = roccat_set_current_profile,
+	.read_button_macro = roccat_read_macro,
 	.write_button = roccat_write_button,
 	.write_resolution_dpi = roccat_write_resolution_dpi,
 };
@@ -396,11 +396,12 @@ steelseries_write_dpi(struct ratbag_resolution *resolution)
 
 		/* when using lists the entries are enumerated in reverse */
 		if (dpilist) {
-			for (i = 0; i < (int)resolution->ndpis; i++) {
-				if (resolution->dpis[i] == resolution->dpi_x)
-					break;
-			}
-			i = resolution->ndpis - i;
+			i = ratbag_resolution_get_dpi_index(resolution,
+							    resolution->dpi_x);
+			if (i < 0)
+				i = 0;
+			else
+				i = ratbag_resolution_get_num_dpis(resolution) - i;
 		} else {
 			i = resolution->dpi_x / dpirange->step - 1;
 		}
@@ -887,9 +888,11 @@ steelseries_write_profile(struct ratbag_profile *profile)
 	int rc;
 	bool buttons_dirty = false;
 
-	rc = steelseries_write_report_rate(profile);
-	if (rc != 0)
-		return rc;
+	if (profile->rate_dirty) {
+		rc = steelseries_write_report_rate(profile);
+		if (rc != 0)
+			return rc;
+	}
 
 	ratbag_profile_for_each_resolution(profile, resolution) {
 		if (!resolution->dirty)
@@ -932,7 +935,8 @@ static int
 steelseries_commit(struct ratbag_device *device)
 {
 	struct ratbag_profile *profile;
-	int rc = 0;
+	bool written = false;
+	int rc = 0, save_rc;
 
 	list_for_each(profile, &device->profiles, link) {
 		if (!profile->dirty)
@@ -943,16 +947,22 @@ steelseries_commit(struct ratbag_device *device)
 
 		rc = steelseries_write_profile(profile);
 		if (rc)
-			return rc;
+			break;
 
-		/* persist the current settings on the device */
+		written = true;
+	}
 
-		rc = steelseries_write_save(device);
-		if (rc)
-			return rc;
+	/* persist the current settings on the device, saving writes to
+	 * the flash so only do it once for the whole commit. If a later
+	 * profile failed, still save the ones already written so the
+	 * device doesn't lose them on the next power cycle */
+	if (written) {
+		save_rc = steelseries_write_save(device);
+		if (!rc)
+			rc = save_rc;
 	}
 
-	return 0;
+	return rc;
 }
 
 static void
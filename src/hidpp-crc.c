@@ -0,0 +1,112 @@
+/*
+ * HID++ CRC-CCITT
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * CRC-CCITT as used by the HID++ onboard memory: polynomial 0x1021, MSB
+ * first, seed 0xFFFF, no final xor.
+ *
+ * hidpp_crc_ccitt_tables[0] is the classic byte-wise lookup table,
+ * hidpp_crc_ccitt_tables[k][v] is the CRC contribution of byte v followed by
+ * k zero bytes, so eight bytes can be folded in with eight independent
+ * lookups (slice-by-8). The tables are generated at build time by
+ * src/build-hidpp-crc-tables.py.
+ */
+
+#include "config.h"
+
+#include "hidpp-crc.h"
+#include "hidpp-crc-tables.h"
+
+#define CRC_CCITT_SEED	0xFFFF
+
+/*
+ * The following crc computation has been provided by Logitech
+ */
+uint16_t
+hidpp_crc_ccitt_bytewise(const uint8_t *data, unsigned int length)
+{
+	uint16_t crc, temp, quick;
+	unsigned int i;
+
+	crc = CRC_CCITT_SEED;
+
+	for (i = 0; i < length; i++) {
+		temp = (crc >> 8) ^ (*data++);
+		crc <<= 8;
+		quick = temp ^ (temp >> 4);
+		crc ^= quick;
+		quick <<= 5;
+		crc ^= quick;
+		quick <<= 7;
+		crc ^= quick;
+	}
+
+	return crc;
+}
+
+static inline uint16_t
+crc_ccitt_update_table(uint16_t crc, const uint8_t *data, unsigned int length)
+{
+	const uint16_t *t0 = hidpp_crc_ccitt_tables[0];
+
+	while (length--)
+		crc = (crc << 8) ^ t0[(crc >> 8) ^ *data++];
+
+	return crc;
+}
+
+uint16_t
+hidpp_crc_ccitt_table(const uint8_t *data, unsigned int length)
+{
+	return crc_ccitt_update_table(CRC_CCITT_SEED, data, length);
+}
+
+uint16_t
+hidpp_crc_ccitt_slice8(const uint8_t *data, unsigned int length)
+{
+	const uint16_t (*t)[256] = hidpp_crc_ccitt_tables;
+	uint16_t crc = CRC_CCITT_SEED;
+
+	for (; length >= 8; length -= 8, data += 8) {
+		crc = t[7][data[0] ^ (crc >> 8)] ^
+		      t[6][data[1] ^ (crc & 0xff)] ^
+		      t[5][data[2]] ^
+		      t[4][data[3]] ^
+		      t[3][data[4]] ^
+		      t[2][data[5]] ^
+		      t[1][data[6]] ^
+		      t[0][data[7]];
+	}
+
+	return crc_ccitt_update_table(crc, data, length);
+}
+
+uint16_t
+hidpp_crc_ccitt(const uint8_t *data, unsigned int length)
+{
+	/* slice-by-8 wins from 16 bytes up, see test/bench-hidpp-crc.c,
+	 * and falls back to the byte-wise table for the tail */
+	return hidpp_crc_ccitt_slice8(data, length);
+}
@@ -0,0 +1,41 @@
+/*
+ * HID++ CRC-CCITT
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Compute the CRC-CCITT of the data as used by HID++ onboard memory.
+ *
+ * Uses the fastest of the implementations below.
+ */
+uint16_t hidpp_crc_ccitt(const uint8_t *data, unsigned int length);
+
+/* The individual implementations, all give the same result. Only exposed
+ * for the tests and benchmarks. */
+uint16_t hidpp_crc_ccitt_bytewise(const uint8_t *data, unsigned int length);
+uint16_t hidpp_crc_ccitt_table(const uint8_t *data, unsigned int length);
+uint16_t hidpp_crc_ccitt_slice8(const uint8_t *data, unsigned int length);
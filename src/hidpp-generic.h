@@ -33,6 +33,7 @@
 #include <stddef.h>
 
 #include "libratbag-util.h"
+#include "hidpp-crc.h"
 
 #define HIDPP_RECEIVER_IDX			0xFF
 #define HIDPP_WIRED_DEVICE_IDX			0x00
@@ -181,8 +182,6 @@ hidpp_log_buffer(struct hidpp_device *dev,
 #define hidpp_log_buf_info(li_, h_, buf_, len_) hidpp_log_buffer(li_, HIDPP_LOG_PRIORITY_INFO, h_, buf_, len_)
 #define hidpp_log_buf_error(li_, h_, buf_, len_) hidpp_log_buffer(li_, HIDPP_LOG_PRIORITY_ERROR, h_, buf_, len_)
 
-uint16_t hidpp_crc_ccitt(uint8_t *data, unsigned int length);
-
 static inline uint16_t
 hidpp_be_u16_to_cpu(uint16_t data)
 {
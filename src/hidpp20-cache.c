@@ -0,0 +1,211 @@
+/*
+ * HID++ 2.0 probe cache
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "hidpp20-cache.h"
+#include "libratbag-private.h"
+
+#define HIDPP20_CACHE_GROUP		"Cache"
+#define HIDPP20_CACHE_GROUP_PROFILES	"OnboardProfiles"
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(GKeyFile *, g_key_file_free);
+DEFINE_TRIVIAL_CLEANUP_FUNC(GError *, g_error_free);
+
+const char *
+hidpp20_cache_get_dir(void)
+{
+	const char *statedir;
+
+	statedir = getenv("LIBRATBAG_STATE_DIR");
+	if (!statedir)
+		statedir = LIBRATBAG_STATE_DIR;
+
+	return statedir;
+}
+
+GKeyFile *
+hidpp20_cache_load(struct ratbag *ratbag, const char *path,
+		   const char *firmware)
+{
+	_cleanup_(g_key_file_freep) GKeyFile *keyfile = NULL;
+	_cleanup_(g_error_freep) GError *error = NULL;
+	_cleanup_(freep) char *cached_firmware = NULL;
+	int version;
+
+	keyfile = g_key_file_new();
+	if (!g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error)) {
+		log_debug(ratbag, "hidpp20: no probe cache in %s: %s\n",
+			  path, error->message);
+		return NULL;
+	}
+
+	version = g_key_file_get_integer(keyfile, HIDPP20_CACHE_GROUP, "Version", NULL);
+	cached_firmware = g_key_file_get_string(keyfile, HIDPP20_CACHE_GROUP, "Firmware", NULL);
+	if (version != HIDPP20_CACHE_VERSION ||
+	    !cached_firmware || !streq(cached_firmware, firmware)) {
+		log_debug(ratbag, "hidpp20: probe cache %s is outdated\n", path);
+		return NULL;
+	}
+
+	log_debug(ratbag, "hidpp20: using probe cache %s\n", path);
+
+	return g_steal_pointer(&keyfile);
+}
+
+int
+hidpp20_cache_get_features(GKeyFile *keyfile,
+			   struct hidpp20_feature **features,
+			   unsigned int *count)
+{
+	_cleanup_free_ int *pages = NULL;
+	_cleanup_free_ int *types = NULL;
+	_cleanup_free_ int *versions = NULL;
+	gsize npages = 0, ntypes = 0, nversions = 0;
+	struct hidpp20_feature *list;
+	unsigned int i;
+
+	pages = g_key_file_get_integer_list(keyfile, HIDPP20_CACHE_GROUP,
+					    "Features", &npages, NULL);
+	types = g_key_file_get_integer_list(keyfile, HIDPP20_CACHE_GROUP,
+					    "FeatureTypes", &ntypes, NULL);
+	versions = g_key_file_get_integer_list(keyfile, HIDPP20_CACHE_GROUP,
+					       "FeatureVersions", &nversions, NULL);
+	if (!pages || !types || !versions ||
+	    npages != ntypes || npages != nversions ||
+	    npages == 0 || npages > 0xff)
+		return -EINVAL;
+
+	list = zalloc(npages * sizeof(*list));
+	for (i = 0; i < npages; i++) {
+		list[i].feature = pages[i];
+		list[i].type = types[i];
+		list[i].version = versions[i];
+	}
+
+	*features = list;
+	*count = npages;
+
+	return 0;
+}
+
+void
+hidpp20_cache_get_sectors(GKeyFile *keyfile,
+			  struct hidpp20_profiles *profiles)
+{
+	unsigned int i;
+
+	if (g_key_file_get_integer(keyfile, HIDPP20_CACHE_GROUP_PROFILES, "SectorSize", NULL) != profiles->sector_size ||
+	    g_key_file_get_integer(keyfile, HIDPP20_CACHE_GROUP_PROFILES, "Profiles", NULL) != profiles->num_profiles)
+		return;
+
+	for (i = 0; i <= profiles->num_profiles; i++) {
+		_cleanup_free_ char *str = NULL;
+		_cleanup_free_ guchar *data = NULL;
+		char key[16];
+		gsize len = 0;
+
+		sprintf_safe(key, "Sector%u", i);
+		str = g_key_file_get_string(keyfile, HIDPP20_CACHE_GROUP_PROFILES, key, NULL);
+		if (!str)
+			continue;
+
+		data = g_base64_decode(str, &len);
+		if (len != profiles->sector_size)
+			continue;
+
+		memcpy(profiles->shadow + i * profiles->sector_size, data, len);
+		profiles->shadow_valid[i] = true;
+	}
+}
+
+int
+hidpp20_cache_save(struct ratbag *ratbag, const char *path,
+		   const char *firmware,
+		   const struct hidpp20_feature *features, unsigned int count,
+		   const struct hidpp20_profiles *profiles)
+{
+	_cleanup_(g_key_file_freep) GKeyFile *keyfile = NULL;
+	_cleanup_(g_error_freep) GError *error = NULL;
+	_cleanup_free_ char *dir = NULL;
+	_cleanup_free_ int *pages = NULL;
+	_cleanup_free_ int *types = NULL;
+	_cleanup_free_ int *versions = NULL;
+	unsigned int i;
+
+	keyfile = g_key_file_new();
+	g_key_file_set_integer(keyfile, HIDPP20_CACHE_GROUP, "Version", HIDPP20_CACHE_VERSION);
+	g_key_file_set_string(keyfile, HIDPP20_CACHE_GROUP, "Firmware", firmware);
+
+	pages = zalloc(count * sizeof(*pages));
+	types = zalloc(count * sizeof(*types));
+	versions = zalloc(count * sizeof(*versions));
+	for (i = 0; i < count; i++) {
+		pages[i] = features[i].feature;
+		types[i] = features[i].type;
+		versions[i] = features[i].version;
+	}
+	g_key_file_set_integer_list(keyfile, HIDPP20_CACHE_GROUP, "Features", pages, count);
+	g_key_file_set_integer_list(keyfile, HIDPP20_CACHE_GROUP, "FeatureTypes", types, count);
+	g_key_file_set_integer_list(keyfile, HIDPP20_CACHE_GROUP, "FeatureVersions", versions, count);
+
+	if (profiles) {
+		g_key_file_set_integer(keyfile, HIDPP20_CACHE_GROUP_PROFILES, "SectorSize", profiles->sector_size);
+		g_key_file_set_integer(keyfile, HIDPP20_CACHE_GROUP_PROFILES, "Profiles", profiles->num_profiles);
+
+		for (i = 0; i <= profiles->num_profiles; i++) {
+			_cleanup_free_ char *str = NULL;
+			char key[16];
+
+			if (!profiles->shadow_valid[i])
+				continue;
+
+			sprintf_safe(key, "Sector%u", i);
+			str = g_base64_encode(profiles->shadow + i * profiles->sector_size,
+					      profiles->sector_size);
+			g_key_file_set_string(keyfile, HIDPP20_CACHE_GROUP_PROFILES, key, str);
+		}
+	}
+
+	dir = g_path_get_dirname(path);
+	if (g_mkdir_with_parents(dir, 0755) < 0) {
+		int rc = -errno;
+
+		log_debug(ratbag, "hidpp20: failed to create %s: %s\n",
+			  dir, strerror(-rc));
+		return rc;
+	}
+
+	if (!g_key_file_save_to_file(keyfile, path, &error)) {
+		log_debug(ratbag, "hidpp20: failed to write probe cache %s: %s\n",
+			  path, error->message);
+		return -EIO;
+	}
+
+	return 0;
+}
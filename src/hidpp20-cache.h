@@ -0,0 +1,86 @@
+/*
+ * HID++ 2.0 probe cache
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The feature list and the user sectors of the onboard profiles are cached
+ * in a keyfile in the state directory, keyed by the device ids, unit id and
+ * firmware versions. The cached sectors are only used after checking their
+ * CRC against the device.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "hidpp20.h"
+#include "libratbag.h"
+
+#define HIDPP20_CACHE_VERSION		2
+
+/**
+ * The directory the cache files go to, $LIBRATBAG_STATE_DIR if set.
+ */
+const char *
+hidpp20_cache_get_dir(void);
+
+/**
+ * Loads a cache file. Returns NULL if there is no cache file, if it can't
+ * be parsed or if it is for another version of the cache or another
+ * firmware.
+ */
+GKeyFile *
+hidpp20_cache_load(struct ratbag *ratbag, const char *path,
+		   const char *firmware);
+
+/**
+ * Reads the feature list from the cache into a newly allocated array.
+ *
+ * @return 0 on success or -EINVAL if the list is missing or inconsistent
+ */
+int
+hidpp20_cache_get_features(GKeyFile *keyfile,
+			   struct hidpp20_feature **features,
+			   unsigned int *count);
+
+/**
+ * Fills the shadow copies of the user sectors of profiles from the cache,
+ * if the cache is for the same sector size and number of profiles.
+ * Sectors missing from the cache are left alone.
+ */
+void
+hidpp20_cache_get_sectors(GKeyFile *keyfile,
+			  struct hidpp20_profiles *profiles);
+
+/**
+ * Writes the feature list and the valid shadow sectors of profiles, which
+ * may be NULL, to the cache file, creating its directory if need be.
+ *
+ * @return 0 on success or a negative errno
+ */
+int
+hidpp20_cache_save(struct ratbag *ratbag, const char *path,
+		   const char *firmware,
+		   const struct hidpp20_feature *features, unsigned int count,
+		   const struct hidpp20_profiles *profiles);
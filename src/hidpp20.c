@@ -114,24 +114,42 @@ hidpp20_get_quirk_string(enum hidpp20_quirk quirk)
 	abort();
 }
 
+/* msg->address is 4 MSB: subcommand, 4 LSB: 4-bit SW identifier so
+ * the device knows who to respond to. The value 0 is reserved for
+ * notifications, so we rotate through 0x1-0xf for each request and use
+ * the identifier to match replies to requests that are in flight. */
+#define HIDPP20_SW_ID_MASK				0x0f
+
+static uint8_t
+hidpp20_next_sw_id(struct hidpp20_device *device)
+{
+	device->sw_id = (device->sw_id % HIDPP20_SW_ID_MASK) + 1;
+
+	return device->sw_id;
+}
+
+struct hidpp20_request {
+	union hidpp20_message *msg;
+	union hidpp20_message request;
+	int status;
+	bool in_flight;
+};
+
 static int
-hidpp20_request_command_allow_error(struct hidpp20_device *device, union hidpp20_message *msg,
-				    bool allow_error)
+hidpp20_request_submit(struct hidpp20_device *device,
+		       struct hidpp20_request *request)
 {
-	union hidpp20_message read_buffer;
-	int ret;
-	uint8_t hidpp_err = 0;
+	union hidpp20_message *msg = &request->request;
 	size_t msg_len;
+	int ret;
 
-	/* msg->address is 4 MSB: subcommand, 4 LSB: 4-bit SW identifier so
-	 * the device knows who to respond to. kernel uses 0x1 */
-	const int DEVICE_SW_ID = 0x8;
+	*msg = *request->msg;
 
-	if (msg->msg.address & 0xf) {
+	if (msg->msg.address & HIDPP20_SW_ID_MASK) {
 		hidpp_log_raw(&device->base, "hidpp20 error: sw address is already set\n");
 		return -EINVAL;
 	}
-	msg->msg.address |= DEVICE_SW_ID;
+	msg->msg.address |= hidpp20_next_sw_id(device);
 
 	/* some mice don't support short reports */
 	if (msg->msg.report_id == REPORT_ID_SHORT && !(device->base.supported_report_types & HIDPP_REPORT_SHORT))
@@ -148,69 +166,174 @@ hidpp20_request_command_allow_error(struct hidpp20_device *device, union hidpp20
 	/* Send the message to the Device */
 	ret = hidpp_write_command(&device->base, msg->data, msg_len);
 	if (ret)
-		goto out_err;
+		return ret;
 
-	/*
-	 * Now read the answers from the device:
-	 * loop until we get the actual answer or an error code.
-	 */
-	do {
-		ret = hidpp_read_response(&device->base, read_buffer.data, LONG_MESSAGE_LENGTH);
+	request->in_flight = true;
 
-		/* Wait and retry if the USB timed out */
-		if (ret == -ETIMEDOUT) {
-			msleep(10);
-			ret = hidpp_read_response(&device->base, read_buffer.data, LONG_MESSAGE_LENGTH);
-		}
+	return 0;
+}
+
+/**
+ * Matches a message read from the device against the requests in flight.
+ * Answers are matched on the feature index and function/sw id, errors on
+ * the feature index and function/sw id they carry in their payload.
+ */
+static struct hidpp20_request *
+hidpp20_request_match(struct hidpp20_device *device,
+		      struct hidpp20_request *requests,
+		      unsigned int count,
+		      union hidpp20_message *reply,
+		      bool allow_error)
+{
+	unsigned int i;
+	uint8_t hidpp_err;
+
+	if (reply->msg.report_id != REPORT_ID_SHORT &&
+	    reply->msg.report_id != REPORT_ID_LONG)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		struct hidpp20_request *request = &requests[i];
+		union hidpp20_message *msg = &request->request;
 
-		if (read_buffer.msg.report_id != REPORT_ID_SHORT &&
-		    read_buffer.msg.report_id != REPORT_ID_LONG)
+		if (!request->in_flight)
 			continue;
 
 		/* actual answer */
-		if (read_buffer.msg.sub_id == msg->msg.sub_id &&
-		    read_buffer.msg.address == msg->msg.address)
-			break;
+		if (reply->msg.sub_id == msg->msg.sub_id &&
+		    reply->msg.address == msg->msg.address) {
+			*request->msg = *reply;
+			request->status = 0;
+			return request;
+		}
 
 		/* error */
-		if ((read_buffer.msg.sub_id == __ERROR_MSG ||
-		     read_buffer.msg.sub_id == 0xff) &&
-		    read_buffer.msg.address == msg->msg.sub_id &&
-		    read_buffer.msg.parameters[0] == msg->msg.address) {
-			hidpp_err = read_buffer.msg.parameters[1];
+		if ((reply->msg.sub_id == __ERROR_MSG ||
+		     reply->msg.sub_id == 0xff) &&
+		    reply->msg.address == msg->msg.sub_id &&
+		    reply->msg.parameters[0] == msg->msg.address) {
+			hidpp_err = reply->msg.parameters[1];
 			if (allow_error)
 				hidpp_log_debug(&device->base,
 						"    HID++ error from the device (%d): %s (%02x)\n",
-						read_buffer.msg.device_idx,
+						reply->msg.device_idx,
 						hidpp20_errors[hidpp_err] ? hidpp20_errors[hidpp_err] : "Undocumented error code",
 						hidpp_err);
 			else
 				hidpp_log_error(&device->base,
 						"    HID++ error from the device (%d): %s (%02x)\n",
-						read_buffer.msg.device_idx,
+						reply->msg.device_idx,
 						hidpp20_errors[hidpp_err] ? hidpp20_errors[hidpp_err] : "Undocumented error code",
 						hidpp_err);
+			request->status = hidpp_err;
+			return request;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Sends count requests to the device, keeping at most
+ * device->max_in_flight of them in flight at any time, and collects the
+ * replies in whatever order the device sends them.
+ *
+ * On success, each message in msgs is replaced with its answer. Once a
+ * request fails, no further requests are sent but the replies to the ones
+ * already in flight are still drained from the device.
+ *
+ * returns 0 on success, the HID++ error code of the first failed request
+ * or a negative errno.
+ */
+static int
+hidpp20_request_commands_allow_error(struct hidpp20_device *device,
+				     union hidpp20_message *msgs,
+				     unsigned int count,
+				     bool allow_error)
+{
+	_cleanup_free_ struct hidpp20_request *requests = NULL;
+	union hidpp20_message read_buffer;
+	struct hidpp20_request *request;
+	unsigned int max_in_flight, in_flight = 0, sent = 0, done = 0;
+	int ret = 0, rc;
+
+	if (count == 0)
+		return 0;
+
+	max_in_flight = max(1U, min(device->max_in_flight, HIDPP20_SW_ID_MASK - 1U));
+	requests = zalloc(count * sizeof(*requests));
+	for (unsigned int i = 0; i < count; i++)
+		requests[i].msg = &msgs[i];
+
+	while (done < count) {
+		/* fill the pipeline */
+		while (ret == 0 && sent < count && in_flight < max_in_flight) {
+			rc = hidpp20_request_submit(device, &requests[sent]);
+			if (rc) {
+				ret = rc;
+				break;
+			}
+			sent++;
+			in_flight++;
+		}
+
+		if (in_flight == 0)
 			break;
+
+		/*
+		 * Now read the answers from the device:
+		 * loop until we get an answer or an error code for one of
+		 * the requests in flight.
+		 */
+		rc = hidpp_read_response(&device->base, read_buffer.data, LONG_MESSAGE_LENGTH);
+
+		/* Wait and retry if the USB timed out */
+		if (rc == -ETIMEDOUT) {
+			msleep(10);
+			rc = hidpp_read_response(&device->base, read_buffer.data, LONG_MESSAGE_LENGTH);
 		}
-	} while (ret > 0);
 
-	if (ret < 0) {
-		hidpp_log_error(&device->base, "    USB error: %s (%d)\n", strerror(-ret), -ret);
-		perror("write");
-		goto out_err;
-	}
+		if (rc <= 0) {
+			rc = rc ? rc : -EIO;
+			hidpp_log_error(&device->base, "    USB error: %s (%d)\n", strerror(-rc), -rc);
+			if (ret == 0)
+				ret = rc;
 
-	if (!hidpp_err) {
-		/* copy the answer for the caller */
-		*msg = read_buffer;
-	}
+			/* the device may not cope with several requests at
+			 * once, fall back to one request at a time */
+			if (rc == -ETIMEDOUT && in_flight > 1) {
+				hidpp_log_debug(&device->base,
+						"hidpp20: disabling request pipelining\n");
+				device->max_in_flight = 1;
+			}
+
+			/* the replies still in flight are lost */
+			break;
+		}
 
-	ret = hidpp_err;
+		request = hidpp20_request_match(device, requests, sent,
+						&read_buffer, allow_error);
+		if (!request)
+			continue;
+
+		request->in_flight = false;
+		in_flight--;
+		done++;
+
+		if (request->status && ret == 0)
+			ret = request->status;
+	}
 
-out_err:
 	return ret;
 }
 
+static int
+hidpp20_request_command_allow_error(struct hidpp20_device *device, union hidpp20_message *msg,
+				    bool allow_error)
+{
+	return hidpp20_request_commands_allow_error(device, msg, 1, allow_error);
+}
+
 int
 hidpp20_request_command(struct hidpp20_device *device, union hidpp20_message *msg)
 {
@@ -219,6 +342,16 @@ hidpp20_request_command(struct hidpp20_device *device, union hidpp20_message *ms
 	return ret > 0 ? -EPROTO : ret;
 }
 
+int
+hidpp20_request_commands(struct hidpp20_device *device,
+			 union hidpp20_message *msgs,
+			 unsigned int count)
+{
+	int ret = hidpp20_request_commands_allow_error(device, msgs, count, false);
+
+	return ret > 0 ? -EPROTO : ret;
+}
+
 /* -------------------------------------------------------------------------- */
 /* 0x0000: Root                                                               */
 /* -------------------------------------------------------------------------- */
@@ -228,6 +361,40 @@ hidpp20_request_command(struct hidpp20_device *device, union hidpp20_message *ms
 #define CMD_ROOT_GET_FEATURE				0x00
 #define CMD_ROOT_GET_PROTOCOL_VERSION			0x10
 
+/**
+ * The features are looked up in an open addressing hash table mapping
+ * the feature page to its index in the feature list. Index 0 is the root
+ * feature which is never looked up, so it marks the empty slots.
+ */
+static inline unsigned int
+hidpp20_feature_map_hash(uint16_t feature)
+{
+	return ((feature * 40503U) & 0xffff) >> (16 - HIDPP20_FEATURE_MAP_BITS);
+}
+
+static void
+hidpp20_feature_map_build(struct hidpp20_device *device)
+{
+	const unsigned int mask = HIDPP20_FEATURE_MAP_SIZE - 1;
+	unsigned int i, slot;
+
+	memset(device->feature_map, 0, sizeof(device->feature_map));
+
+	/* feature 0x0000 is always at 0 */
+	for (i = 1; i < device->feature_count; i++) {
+		uint16_t feature = device->feature_list[i].feature;
+
+		slot = hidpp20_feature_map_hash(feature);
+		while (device->feature_map[slot] != 0 &&
+		       device->feature_list[device->feature_map[slot]].feature != feature)
+			slot = (slot + 1) & mask;
+
+		/* keep the first index if the device lists a feature twice */
+		if (device->feature_map[slot] == 0)
+			device->feature_map[slot] = i;
+	}
+}
+
 /**
  * Returns the feature index or 0x00 if it is not found.
  */
@@ -235,21 +402,53 @@ static uint8_t
 hidpp_root_get_feature_idx(struct hidpp20_device *device,
 			   uint16_t feature)
 {
-	unsigned i;
+	const unsigned int mask = HIDPP20_FEATURE_MAP_SIZE - 1;
+	unsigned int slot;
+	uint8_t idx;
 
 	/* error or not, we should not ask for feature 0 */
 	if (feature == 0x0000)
 		return 0;
 
-	/* feature 0x0000 is always at 0 */
-	for (i = 1; i < device->feature_count; i++) {
-		if (device->feature_list[i].feature == feature)
-			return i;
+	slot = hidpp20_feature_map_hash(feature);
+	while ((idx = device->feature_map[slot]) != 0) {
+		if (device->feature_list[idx].feature == feature)
+			return idx;
+		slot = (slot + 1) & mask;
 	}
 
 	return 0;
 }
 
+int
+hidpp20_device_get_feature(struct hidpp20_device *device,
+			   uint16_t feature,
+			   uint8_t *feature_index,
+			   uint8_t *feature_type,
+			   uint8_t *feature_version)
+{
+	uint8_t idx;
+
+	/* the root feature is always at index 0 */
+	if (feature == HIDPP_PAGE_ROOT) {
+		idx = 0;
+		if (device->feature_count == 0)
+			return -ENOTSUP;
+	} else {
+		idx = hidpp_root_get_feature_idx(device, feature);
+		if (idx == 0)
+			return -ENOTSUP;
+	}
+
+	if (feature_index)
+		*feature_index = idx;
+	if (feature_type)
+		*feature_type = device->feature_list[idx].type;
+	if (feature_version)
+		*feature_version = device->feature_list[idx].version;
+
+	return 0;
+}
 
 int
 hidpp_root_get_feature(struct hidpp20_device *device,
@@ -339,7 +538,8 @@ hidpp20_feature_set_get_feature_id(struct hidpp20_device *device,
 				   uint8_t reg,
 				   uint8_t feature_index,
 				   uint16_t *feature,
-				   uint8_t *type)
+				   uint8_t *type,
+				   uint8_t *version)
 {
 	int rc;
 	union hidpp20_message msg = {
@@ -356,6 +556,8 @@ hidpp20_feature_set_get_feature_id(struct hidpp20_device *device,
 
 	*feature = get_unaligned_be_u16(msg.msg.parameters);
 	*type = msg.msg.parameters[2];
+	/* only reported by feature set version 1 and later, 0 otherwise */
+	*version = msg.msg.parameters[3];
 
 	return 0;
 }
@@ -401,13 +603,15 @@ hidpp20_feature_set_get(struct hidpp20_device *device)
 							feature_index,
 							i,
 							&flist[i].feature,
-							&flist[i].type);
+							&flist[i].type,
+							&flist[i].version);
 		if (rc)
 			goto err;
 	}
 
 	device->feature_list = flist;
 	device->feature_count = feature_count;
+	hidpp20_feature_map_build(device);
 
 	return 0;
 err:
@@ -415,6 +619,103 @@ err:
 	return rc;
 }
 
+/* -------------------------------------------------------------------------- */
+/* 0x0003: Device Info                                                        */
+/* -------------------------------------------------------------------------- */
+
+#define CMD_DEVICE_INFO_GET_DEVICE_INFO			0x00
+#define CMD_DEVICE_INFO_GET_FW_INFO			0x10
+
+static uint8_t
+hidpp20_device_info_get_feature_idx(struct hidpp20_device *device)
+{
+	uint8_t feature_index, feature_type, feature_version;
+	int rc;
+
+	if (device->feature_count > 0) {
+		rc = hidpp20_device_get_feature(device,
+						HIDPP_PAGE_DEVICE_INFO,
+						&feature_index,
+						NULL,
+						NULL);
+		return rc ? 0 : feature_index;
+	}
+
+	/* the feature list has not been fetched yet, ask the root feature */
+	rc = hidpp_root_get_feature(device,
+				    HIDPP_PAGE_DEVICE_INFO,
+				    &feature_index,
+				    &feature_type,
+				    &feature_version);
+	if (rc)
+		return 0;
+
+	return feature_index;
+}
+
+int
+hidpp20_device_info_get_device_info(struct hidpp20_device *device,
+				    struct hidpp20_device_info *info)
+{
+	uint8_t feature_index;
+	int rc;
+	union hidpp20_message msg = {
+		.msg.report_id = REPORT_ID_SHORT,
+		.msg.device_idx = device->index,
+		.msg.address = CMD_DEVICE_INFO_GET_DEVICE_INFO,
+	};
+
+	feature_index = hidpp20_device_info_get_feature_idx(device);
+	if (feature_index == 0)
+		return -ENOTSUP;
+
+	msg.msg.sub_id = feature_index;
+
+	rc = hidpp20_request_command(device, &msg);
+	if (rc)
+		return rc;
+
+	info->entity_count = msg.msg.parameters[0];
+	memcpy(info->unit_id, &msg.msg.parameters[1], sizeof(info->unit_id));
+	memcpy(info->model_id, &msg.msg.parameters[7], sizeof(info->model_id));
+
+	return 0;
+}
+
+int
+hidpp20_device_info_get_fw_info(struct hidpp20_device *device,
+				uint8_t entity,
+				struct hidpp20_fw_info *info)
+{
+	uint8_t feature_index;
+	int rc;
+	union hidpp20_message msg = {
+		.msg.report_id = REPORT_ID_SHORT,
+		.msg.device_idx = device->index,
+		.msg.address = CMD_DEVICE_INFO_GET_FW_INFO,
+		.msg.parameters[0] = entity,
+	};
+
+	feature_index = hidpp20_device_info_get_feature_idx(device);
+	if (feature_index == 0)
+		return -ENOTSUP;
+
+	msg.msg.sub_id = feature_index;
+
+	rc = hidpp20_request_command(device, &msg);
+	if (rc)
+		return rc;
+
+	info->type = msg.msg.parameters[0];
+	memcpy(info->prefix, &msg.msg.parameters[1], 3);
+	info->prefix[3] = '\0';
+	info->number = msg.msg.parameters[4];
+	info->revision = msg.msg.parameters[5];
+	info->build = get_unaligned_be_u16(&msg.msg.parameters[6]);
+
+	return 0;
+}
+
 /* -------------------------------------------------------------------------- */
 /* 0x1000: Battery level status                                               */
 /* -------------------------------------------------------------------------- */
@@ -1867,60 +2168,88 @@ hidpp20_onboard_profiles_get_profiles_desc(struct hidpp20_device *device,
 }
 
 int
-hidpp20_onboard_profiles_read_sector(struct hidpp20_device *device,
-				     uint16_t sector,
-				     uint16_t sector_size,
-				     uint8_t *data)
+hidpp20_onboard_profiles_read_sectors(struct hidpp20_device *device,
+				      const uint16_t *sectors,
+				      unsigned int count,
+				      uint16_t sector_size,
+				      uint8_t *data)
 {
+	_cleanup_free_ union hidpp20_message *msgs = NULL;
+	_cleanup_free_ uint16_t *offsets = NULL;
+	unsigned int chunks = 0, total, s, i;
 	uint16_t offset;
 	uint8_t feature_index;
-	int rc, count;
-	union hidpp20_message buf;
-	union hidpp20_message msg = {
-		.msg.report_id = REPORT_ID_LONG,
-		.msg.device_idx = device->index,
-		.msg.address = CMD_ONBOARD_PROFILES_MEMORY_READ,
-	};
+	int rc;
 
-	hidpp_log_debug(&device->base, "Reading sector 0x%04x\n", sector);
+	if (count == 0)
+		return 0;
+
+	if (sector_size < 16)
+		return -EINVAL;
 
 	feature_index = hidpp_root_get_feature_idx(device,
 						   HIDPP_PAGE_ONBOARD_PROFILES);
 	if (feature_index == 0)
 		return -ENOTSUP;
 
-	msg.msg.sub_id = feature_index;
-	set_unaligned_be_u16(&msg.msg.parameters[0], sector);
-
-	count = sector_size;
-
+	/*
+	 * the firmware replies with an ERR_INVALID_ARGUMENT error
+	 * if we try to read past sector_size - 16, so when we are left with
+	 * less than 16 bytes to read we need to read from sector_size - 16
+	 */
+	offsets = zalloc((sector_size / 16 + 1) * sizeof(*offsets));
 	for (offset = 0; offset < sector_size; offset += 16) {
-		/*
-		 * the firmware replies with an ERR_INVALID_ARGUMENT error
-		 * if we try to read past sector_size - 16, so when we are left with
-		 * less than 16 bytes to read we need to read from sector_size - 16
-		 */
 		offset = (sector_size - offset < 16) ? sector_size - 16 : offset;
-		set_unaligned_be_u16(&msg.msg.parameters[2], offset);
-		buf = msg;
-		rc = hidpp20_request_command(device, &buf);
-		if (rc)
-			return rc;
+		offsets[chunks++] = offset;
+	}
 
-		/* msg.msg.parameters is guaranteed to have a size >= 16 */
-		memcpy(data + offset, buf.msg.parameters, 16);
+	total = count * chunks;
+	msgs = zalloc(total * sizeof(*msgs));
 
-		/*
-		 * no need to check for count >= 0:
-		 * if count is negative, then offset will be greater than
-		 * sector_size, thus stopping the loop.
-		 */
-		count -= 16;
+	for (s = 0; s < count; s++) {
+		hidpp_log_debug(&device->base, "Reading sector 0x%04x\n", sectors[s]);
+
+		for (i = 0; i < chunks; i++) {
+			union hidpp20_message *msg = &msgs[s * chunks + i];
+
+			msg->msg.report_id = REPORT_ID_LONG;
+			msg->msg.device_idx = device->index;
+			msg->msg.sub_id = feature_index;
+			msg->msg.address = CMD_ONBOARD_PROFILES_MEMORY_READ;
+			set_unaligned_be_u16(&msg->msg.parameters[0], sectors[s]);
+			set_unaligned_be_u16(&msg->msg.parameters[2], offsets[i]);
+		}
+	}
+
+	/* send all the reads back to back, the replies are matched to their
+	 * request by the request engine */
+	rc = hidpp20_request_commands(device, msgs, total);
+	if (rc)
+		return rc;
+
+	for (s = 0; s < count; s++) {
+		uint8_t *sector_data = data + s * sector_size;
+
+		/* msg.msg.parameters is guaranteed to have a size >= 16 */
+		for (i = 0; i < chunks; i++)
+			memcpy(sector_data + offsets[i],
+			       msgs[s * chunks + i].msg.parameters,
+			       16);
 	}
 
 	return 0;
 }
 
+int
+hidpp20_onboard_profiles_read_sector(struct hidpp20_device *device,
+				     uint16_t sector,
+				     uint16_t sector_size,
+				     uint8_t *data)
+{
+	return hidpp20_onboard_profiles_read_sectors(device, &sector, 1,
+						     sector_size, data);
+}
+
 static bool
 hidpp20_onboard_profiles_is_sector_valid(struct hidpp20_device *device,
 					 uint16_t sector_size,
@@ -2237,6 +2566,286 @@ hidpp20_onboard_profiles_validate(struct hidpp20_device *device,
 	return true;
 }
 
+/**
+ * Returns the shadow copy of the given sector or NULL if the sector is
+ * not one of the user sectors we keep track of.
+ */
+static uint8_t *
+hidpp20_onboard_profiles_get_shadow(struct hidpp20_profiles *profiles,
+				    uint16_t sector)
+{
+	uint16_t idx = sector - HIDPP20_USER_PROFILES_G402;
+
+	if (idx > profiles->num_profiles)
+		return NULL;
+
+	return profiles->shadow + idx * profiles->sector_size;
+}
+
+static void
+hidpp20_onboard_profiles_update_shadow(struct hidpp20_profiles *profiles,
+				       uint16_t sector,
+				       const uint8_t *data)
+{
+	uint8_t *shadow = hidpp20_onboard_profiles_get_shadow(profiles, sector);
+
+	if (!shadow)
+		return;
+
+	if (data)
+		memcpy(shadow, data, profiles->sector_size);
+	profiles->shadow_valid[sector - HIDPP20_USER_PROFILES_G402] = !!data;
+}
+
+static struct hidpp20_cached_sector *
+hidpp20_onboard_profiles_find_cached(struct hidpp20_profiles *profiles,
+				     uint16_t sector)
+{
+	struct hidpp20_cached_sector *c;
+
+	ARRAY_FOR_EACH(profiles->sector_cache, c) {
+		if (c->last_used && c->sector == sector)
+			return c;
+	}
+
+	return NULL;
+}
+
+/**
+ * Returns the last known content of the given sector, either from the
+ * shadow copies of the user sectors or from the sector cache, or NULL if
+ * the sector has to be read from the device.
+ */
+static const uint8_t *
+hidpp20_onboard_profiles_get_cached(struct hidpp20_profiles *profiles,
+				    uint16_t sector)
+{
+	struct hidpp20_cached_sector *c;
+	uint8_t *shadow;
+
+	shadow = hidpp20_onboard_profiles_get_shadow(profiles, sector);
+	if (shadow) {
+		if (!profiles->shadow_valid[sector - HIDPP20_USER_PROFILES_G402])
+			return NULL;
+		return shadow;
+	}
+
+	c = hidpp20_onboard_profiles_find_cached(profiles, sector);
+	if (!c)
+		return NULL;
+
+	c->last_used = ++profiles->sector_cache_clock;
+
+	return c->data;
+}
+
+/**
+ * Stores the content of a sector read from or written to the device. User
+ * sectors go to their shadow copy, every other sector replaces the least
+ * recently used entry of the sector cache.
+ */
+static void
+hidpp20_onboard_profiles_store_cached(struct hidpp20_profiles *profiles,
+				      uint16_t sector,
+				      const uint8_t *data)
+{
+	struct hidpp20_cached_sector *c, *slot;
+
+	if (hidpp20_onboard_profiles_get_shadow(profiles, sector)) {
+		hidpp20_onboard_profiles_update_shadow(profiles, sector, data);
+		return;
+	}
+
+	slot = hidpp20_onboard_profiles_find_cached(profiles, sector);
+	if (!slot) {
+		slot = &profiles->sector_cache[0];
+		ARRAY_FOR_EACH(profiles->sector_cache, c) {
+			if (c->last_used < slot->last_used)
+				slot = c;
+		}
+	}
+
+	if (!slot->data)
+		slot->data = hidpp20_onboard_profiles_allocate_sector(profiles);
+
+	memcpy(slot->data, data, profiles->sector_size);
+	slot->sector = sector;
+	slot->last_used = ++profiles->sector_cache_clock;
+}
+
+static void
+hidpp20_onboard_profiles_drop_cached(struct hidpp20_profiles *profiles,
+				     uint16_t sector)
+{
+	struct hidpp20_cached_sector *c;
+
+	hidpp20_onboard_profiles_update_shadow(profiles, sector, NULL);
+
+	c = hidpp20_onboard_profiles_find_cached(profiles, sector);
+	if (c)
+		c->last_used = 0;
+}
+
+/**
+ * Writes a user sector unless its content matches what is already on the
+ * device. The CRC is computed and stored in data before the comparison.
+ */
+static int
+hidpp20_onboard_profiles_commit_sector(struct hidpp20_device *device,
+				       struct hidpp20_profiles *profiles,
+				       uint16_t sector,
+				       uint8_t *data)
+{
+	uint16_t sector_size = profiles->sector_size;
+	uint8_t *shadow;
+	uint16_t crc;
+	int rc;
+
+	crc = hidpp_crc_ccitt(data, sector_size - 2);
+	set_unaligned_be_u16(&data[sector_size - 2], crc);
+
+	shadow = hidpp20_onboard_profiles_get_shadow(profiles, sector);
+	if (shadow &&
+	    profiles->shadow_valid[sector - HIDPP20_USER_PROFILES_G402] &&
+	    memcmp(shadow, data, sector_size) == 0) {
+		hidpp_log_debug(&device->base,
+				"Sector 0x%04x is unchanged, skipping\n",
+				sector);
+		return 0;
+	}
+
+	rc = hidpp20_onboard_profiles_write_sector(device, sector, sector_size,
+						   data, false);
+
+	/* on failure we don't know what ended up in the flash */
+	if (rc)
+		hidpp20_onboard_profiles_drop_cached(profiles, sector);
+	else
+		hidpp20_onboard_profiles_store_cached(profiles, sector, data);
+
+	return rc;
+}
+
+/**
+ * Reads count sectors into data like hidpp20_onboard_profiles_read_sectors()
+ * but takes the sectors from their shadow copy or the sector cache when
+ * possible. The sectors read from the device are added to the cache.
+ */
+static int
+hidpp20_onboard_profiles_read_cached_sectors(struct hidpp20_device *device,
+					   struct hidpp20_profiles *profiles,
+					   const uint16_t *sectors,
+					   unsigned int count,
+					   uint8_t *data)
+{
+	uint16_t sector_size = profiles->sector_size;
+	_cleanup_free_ uint16_t *to_read = NULL;
+	_cleanup_free_ unsigned int *indices = NULL;
+	_cleanup_free_ uint8_t *buffer = NULL;
+	unsigned int i, n = 0;
+	int rc;
+
+	to_read = zalloc(count * sizeof(*to_read));
+	indices = zalloc(count * sizeof(*indices));
+
+	for (i = 0; i < count; i++) {
+		const uint8_t *cached = hidpp20_onboard_profiles_get_cached(profiles, sectors[i]);
+
+		if (cached) {
+			hidpp_log_debug(&device->base, "Using cached sector 0x%04x\n", sectors[i]);
+			memcpy(data + i * sector_size, cached, sector_size);
+			continue;
+		}
+
+		indices[n] = i;
+		to_read[n++] = sectors[i];
+	}
+
+	if (n == 0)
+		return 0;
+
+	buffer = zalloc(n * sector_size);
+	rc = hidpp20_onboard_profiles_read_sectors(device, to_read, n, sector_size, buffer);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < n; i++) {
+		uint8_t *d = buffer + i * sector_size;
+
+		memcpy(data + indices[i] * sector_size, d, sector_size);
+		hidpp20_onboard_profiles_store_cached(profiles, to_read[i], d);
+	}
+
+	return 0;
+}
+
+int
+hidpp20_onboard_profiles_verify_shadow(struct hidpp20_device *device,
+				       struct hidpp20_profiles *profiles)
+{
+	uint16_t sector_size = profiles->sector_size;
+	_cleanup_free_ union hidpp20_message *msgs = NULL;
+	unsigned int i, n = 0;
+	uint8_t feature_index;
+	int rc;
+
+	feature_index = hidpp_root_get_feature_idx(device,
+						   HIDPP_PAGE_ONBOARD_PROFILES);
+	if (feature_index == 0)
+		return -ENOTSUP;
+
+	msgs = zalloc((profiles->num_profiles + 1) * sizeof(*msgs));
+
+	/* the last 16 bytes of a sector hold its CRC, if those match for
+	 * every sector we know of, the content does too */
+	for (i = 0; i <= profiles->num_profiles; i++) {
+		union hidpp20_message *msg = &msgs[n];
+
+		if (!profiles->shadow_valid[i])
+			continue;
+
+		msg->msg.report_id = REPORT_ID_LONG;
+		msg->msg.device_idx = device->index;
+		msg->msg.sub_id = feature_index;
+		msg->msg.address = CMD_ONBOARD_PROFILES_MEMORY_READ;
+		set_unaligned_be_u16(&msg->msg.parameters[0], HIDPP20_USER_PROFILES_G402 + i);
+		set_unaligned_be_u16(&msg->msg.parameters[2], sector_size - 16);
+		n++;
+	}
+
+	rc = hidpp20_request_commands(device, msgs, n);
+	if (rc)
+		goto out;
+
+	n = 0;
+	for (i = 0; i <= profiles->num_profiles; i++) {
+		uint8_t *shadow = profiles->shadow + i * sector_size;
+
+		if (!profiles->shadow_valid[i])
+			continue;
+
+		if (memcmp(shadow + sector_size - 16, msgs[n++].msg.parameters, 16)) {
+			hidpp_log_debug(&device->base,
+					"Sector 0x%04x changed on the device\n",
+					HIDPP20_USER_PROFILES_G402 + i);
+			rc = -ESTALE;
+			goto out;
+		}
+	}
+
+out:
+	if (rc) {
+		struct hidpp20_cached_sector *c;
+
+		memset(profiles->shadow_valid, 0,
+		       (profiles->num_profiles + 1) * sizeof(bool));
+		ARRAY_FOR_EACH(profiles->sector_cache, c)
+			c->last_used = 0;
+	}
+
+	return rc;
+}
+
 int
 hidpp20_onboard_profiles_allocate(struct hidpp20_device *device,
 				  struct hidpp20_profiles **profiles_list)
@@ -2270,6 +2879,8 @@ hidpp20_onboard_profiles_allocate(struct hidpp20_device *device,
 
 	profiles = zalloc(sizeof(struct hidpp20_profiles));
 	profiles->profiles = zalloc(info.profile_count * sizeof(struct hidpp20_profile));
+	profiles->shadow = zalloc((info.profile_count + 1) * info.sector_size);
+	profiles->shadow_valid = zalloc((info.profile_count + 1) * sizeof(bool));
 	profiles->sector_size = info.sector_size;
 	profiles->sector_count = info.sector_count;
 	profiles->num_profiles = info.profile_count;
@@ -2374,10 +2985,13 @@ hidpp20_onboard_profiles_read_macro(struct hidpp20_device *device,
 		}
 
 		if (rc == -ENOMEM) {
-			rc = hidpp20_onboard_profiles_read_sector(device,
-								  page,
-								  profiles->sector_size,
-								  memory);
+			uint16_t sector = page;
+
+			rc = hidpp20_onboard_profiles_read_cached_sectors(device,
+									  profiles,
+									  &sector,
+									  1,
+									  memory);
 			if (rc)
 				goto out_err;
 		}
@@ -2476,6 +3090,7 @@ void
 hidpp20_onboard_profiles_destroy(struct hidpp20_profiles *profiles_list)
 {
 	struct hidpp20_profile *profile;
+	struct hidpp20_cached_sector *c;
 	union hidpp20_macro_data **macro;
 	unsigned i;
 
@@ -2490,6 +3105,11 @@ hidpp20_onboard_profiles_destroy(struct hidpp20_profiles *profiles_list)
 		}
 	}
 
+	ARRAY_FOR_EACH(profiles_list->sector_cache, c)
+		free(c->data);
+
+	free(profiles_list->shadow);
+	free(profiles_list->shadow_valid);
 	free(profiles_list->profiles);
 	free(profiles_list);
 }
@@ -2526,11 +3146,10 @@ hidpp20_onboard_profiles_write_dict(struct hidpp20_device *device,
 			   hidpp20_onboard_profiles_compute_dict_size(device,
 								      profiles_list));
 
-	rc = hidpp20_onboard_profiles_write_sector(device,
-						   0x0000,
-						   sector_size,
-						   data,
-						   true);
+	rc = hidpp20_onboard_profiles_commit_sector(device,
+						    profiles_list,
+						    HIDPP20_USER_PROFILES_G402,
+						    data);
 	if (rc)
 		hidpp_log_error(&device->base, "failed to write profile dictionary\n");
 
@@ -2694,39 +3313,15 @@ hidpp20_onboard_profiles_read_led(struct hidpp20_led *led,
 	led->brightness = brightness;
 }
 
-static int
-hidpp20_onboard_profiles_parse_profile(struct hidpp20_device *device,
-				       struct hidpp20_profiles *profiles_list,
-				       unsigned index,
-				       bool check_crc)
+static void
+hidpp20_onboard_profiles_parse_profile_data(struct hidpp20_device *device,
+					    struct hidpp20_profiles *profiles_list,
+					    unsigned index,
+					    uint8_t *data)
 {
-	union hidpp20_internal_profile *pdata;
+	union hidpp20_internal_profile *pdata = (union hidpp20_internal_profile *)data;
 	struct hidpp20_profile *profile = &profiles_list->profiles[index];
-	uint16_t sector = profile->address;
-	_cleanup_free_ uint8_t *data = NULL;
 	unsigned i;
-	int rc;
-
-	if (index >= profiles_list->num_profiles)
-		return -EINVAL;
-
-	data = hidpp20_onboard_profiles_allocate_sector(profiles_list);
-	pdata = (union hidpp20_internal_profile *)data;
-
-	rc = hidpp20_onboard_profiles_read_sector(device,
-						  sector,
-						  profiles_list->sector_size,
-						  data);
-	if (rc < 0)
-		return rc;
-
-	if (check_crc) {
-		if (!hidpp20_onboard_profiles_is_sector_valid(device,
-							      profiles_list->sector_size,
-							      data)) {
-			return -EAGAIN;
-		}
-	}
 
 	profile->report_rate = 1000 / max(1, pdata->profile.report_rate);
 	profile->default_dpi = pdata->profile.default_dpi;
@@ -2758,6 +3353,93 @@ hidpp20_onboard_profiles_parse_profile(struct hidpp20_device *device,
 	}
 	if (i == sizeof(profile->name))
 		memset(profile->name, 0, sizeof(profile->name));
+}
+
+static int
+hidpp20_onboard_profiles_parse_profile(struct hidpp20_device *device,
+				       struct hidpp20_profiles *profiles_list,
+				       unsigned index,
+				       bool check_crc)
+{
+	struct hidpp20_profile *profile = &profiles_list->profiles[index];
+	uint16_t sector = profile->address;
+	_cleanup_free_ uint8_t *data = NULL;
+	int rc;
+
+	if (index >= profiles_list->num_profiles)
+		return -EINVAL;
+
+	data = hidpp20_onboard_profiles_allocate_sector(profiles_list);
+
+	rc = hidpp20_onboard_profiles_read_cached_sectors(device,
+							  profiles_list,
+							  &sector,
+							  1,
+							  data);
+	if (rc < 0)
+		return rc;
+
+	if (check_crc) {
+		if (!hidpp20_onboard_profiles_is_sector_valid(device,
+							      profiles_list->sector_size,
+							      data)) {
+			return -EAGAIN;
+		}
+	}
+
+	hidpp20_onboard_profiles_parse_profile_data(device, profiles_list, index, data);
+
+	return 0;
+}
+
+/**
+ * Reads all user profiles in one batch of requests and parses the ones
+ * with a valid CRC. The profiles that could not be parsed are left with
+ * their enabled bit set in *invalid.
+ *
+ * returns 0 or a negative error if the batch failed as a whole.
+ */
+static int
+hidpp20_onboard_profiles_parse_user_profiles(struct hidpp20_device *device,
+					     struct hidpp20_profiles *profiles_list,
+					     uint32_t *invalid)
+{
+	uint16_t sector_size = profiles_list->sector_size;
+	_cleanup_free_ uint16_t *sectors = NULL;
+	_cleanup_free_ uint8_t *data = NULL;
+	unsigned i;
+	int rc;
+
+	if (profiles_list->num_profiles > sizeof(*invalid) * 8)
+		return -E2BIG;
+
+	sectors = zalloc(profiles_list->num_profiles * sizeof(*sectors));
+	data = zalloc(profiles_list->num_profiles * sector_size);
+
+	for (i = 0; i < profiles_list->num_profiles; i++)
+		sectors[i] = profiles_list->profiles[i].address;
+
+	rc = hidpp20_onboard_profiles_read_cached_sectors(device,
+							  profiles_list,
+							  sectors,
+							  profiles_list->num_profiles,
+							  data);
+	if (rc < 0)
+		return rc;
+
+	*invalid = 0;
+	for (i = 0; i < profiles_list->num_profiles; i++) {
+		uint8_t *d = data + i * sector_size;
+
+		if (!hidpp20_onboard_profiles_is_sector_valid(device, sector_size, d)) {
+			hidpp_log_debug(&device->base, "Profile %u is bad. Falling back to the ROM settings.\n", i);
+			*invalid |= 1U << i;
+			continue;
+		}
+
+		hidpp_log_debug(&device->base, "Parsing profile %u\n", i);
+		hidpp20_onboard_profiles_parse_profile_data(device, profiles_list, i, d);
+	}
 
 	return 0;
 }
@@ -2772,6 +3454,7 @@ hidpp20_onboard_profiles_initialize(struct hidpp20_device *device,
 	uint16_t addr;
 	bool crc_valid;
 	bool read_userdata = true;
+	uint32_t invalid = ~0U;
 
 	assert(profiles);
 
@@ -2782,10 +3465,12 @@ hidpp20_onboard_profiles_initialize(struct hidpp20_device *device,
 
 	data = hidpp20_onboard_profiles_allocate_sector(profiles);
 
-	rc = hidpp20_onboard_profiles_read_sector(device,
-						  HIDPP20_USER_PROFILES_G402,
-						  profiles->sector_size,
-						  data);
+	addr = HIDPP20_USER_PROFILES_G402;
+	rc = hidpp20_onboard_profiles_read_cached_sectors(device,
+							  profiles,
+							  &addr,
+							  1,
+							  data);
 
 	if (rc && device->quirk == HIDPP20_QUIRK_G305) {
 		/* The G305 has a bug where it throws an ERR_INVALID_ARGUMENT
@@ -2829,7 +3514,16 @@ hidpp20_onboard_profiles_initialize(struct hidpp20_device *device,
 	}
 
 read_profiles:
+	/* fetch all user profiles at once, if that fails we fall back to
+	 * reading them one by one below */
+	if (read_userdata &&
+	    hidpp20_onboard_profiles_parse_user_profiles(device, profiles, &invalid) == 0)
+		read_userdata = false;
+
 	for (i = 0; i < profiles->num_profiles; i++) {
+		if (i < 32 && !(invalid & (1U << i)))
+			continue;
+
 		if (read_userdata) {
 			hidpp_log_debug(&device->base, "Parsing profile %u\n", i);
 			rc = hidpp20_onboard_profiles_parse_profile(device,
@@ -2917,7 +3611,6 @@ hidpp20_onboard_profiles_write_profile(struct hidpp20_device *device,
 {
 	union hidpp20_internal_profile *pdata;
 	_cleanup_free_ uint8_t *data = NULL;
-	uint16_t sector_size = profiles_list->sector_size;
 	uint16_t sector = index + 1;
 	struct hidpp20_profile *profile = &profiles_list->profiles[index];
 	unsigned i;
@@ -2953,7 +3646,7 @@ hidpp20_onboard_profiles_write_profile(struct hidpp20_device *device,
 
 	memcpy(pdata->profile.name.txt, profile->name, sizeof(profile->name));
 
-	rc = hidpp20_onboard_profiles_write_sector(device, sector, sector_size, data, true);
+	rc = hidpp20_onboard_profiles_commit_sector(device, profiles_list, sector, data);
 	if (rc < 0) {
 		hidpp_log_error(&device->base, "failed to write profile\n");
 		return rc;
@@ -3040,7 +3733,7 @@ hidpp20_onboard_profiles_get_code_from_special(enum ratbag_button_action_special
 /* -------------------------------------------------------------------------- */
 
 struct hidpp20_device *
-hidpp20_device_new(const struct hidpp_device *base, unsigned int idx, struct hidpp_hid_report *reports, unsigned int num_reports)
+hidpp20_device_new_uninitialized(const struct hidpp_device *base, unsigned int idx, struct hidpp_hid_report *reports, unsigned int num_reports)
 {
 	struct hidpp20_device *dev;
 	int rc;
@@ -3055,6 +3748,8 @@ hidpp20_device_new(const struct hidpp_device *base, unsigned int idx, struct hid
 
 	dev->led_ext_caps = 0;
 
+	dev->max_in_flight = HIDPP20_MAX_IN_FLIGHT;
+
 	hidpp_get_supported_report_types(&(dev->base), reports, num_reports);
 
 	if (!(dev->base.supported_report_types & HIDPP_REPORT_SHORT) &&
@@ -3070,13 +3765,47 @@ hidpp20_device_new(const struct hidpp_device *base, unsigned int idx, struct hid
 	if (dev->proto_major < 2)
 		goto err;
 
-	rc = hidpp20_feature_set_get(dev);
+	return dev;
+err:
+	free(dev);
+	return NULL;
+}
+
+int
+hidpp20_device_init_features(struct hidpp20_device *device)
+{
+	return hidpp20_feature_set_get(device);
+}
+
+void
+hidpp20_device_set_features(struct hidpp20_device *device,
+			    const struct hidpp20_feature *features,
+			    unsigned int count)
+{
+	free(device->feature_list);
+	device->feature_list = zalloc((count + 1) * sizeof(*features));
+	memcpy(device->feature_list, features, count * sizeof(*features));
+	device->feature_count = count;
+	hidpp20_feature_map_build(device);
+}
+
+struct hidpp20_device *
+hidpp20_device_new(const struct hidpp_device *base, unsigned int idx, struct hidpp_hid_report *reports, unsigned int num_reports)
+{
+	struct hidpp20_device *dev;
+	int rc;
+
+	dev = hidpp20_device_new_uninitialized(base, idx, reports, num_reports);
+	if (!dev)
+		return NULL;
+
+	rc = hidpp20_device_init_features(dev);
 	if (rc < 0)
 		goto err;
 
 	return dev;
 err:
-	free(dev);
+	hidpp20_device_destroy(dev);
 	return NULL;
 }
 
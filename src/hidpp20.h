@@ -49,8 +49,13 @@ union hidpp20_message {
 struct hidpp20_feature {
 	uint16_t feature;
 	uint8_t type;
+	uint8_t version;
 };
 
+/* a device has at most 256 features, keep the table at most half full */
+#define HIDPP20_FEATURE_MAP_BITS 9
+#define HIDPP20_FEATURE_MAP_SIZE (1 << HIDPP20_FEATURE_MAP_BITS)
+
 enum hidpp20_quirk {
 	HIDPP20_QUIRK_NONE,
 	HIDPP20_QUIRK_G305,
@@ -64,12 +69,31 @@ struct hidpp20_device {
 	unsigned proto_minor;
 	unsigned feature_count;
 	struct hidpp20_feature *feature_list;
+	uint8_t feature_map[HIDPP20_FEATURE_MAP_SIZE]; /* feature page -> index */
 	enum hidpp20_quirk quirk;
 	unsigned int led_ext_caps;
+	uint8_t sw_id;			/* last software id used */
+	unsigned int max_in_flight;	/* max requests sent before a reply */
 };
 
+/* default number of requests in flight per device, must be lower than
+ * the 15 available software ids */
+#define HIDPP20_MAX_IN_FLIGHT 4
+
 int hidpp20_request_command(struct hidpp20_device *dev, union hidpp20_message *msg);
 
+/**
+ * Sends count requests to the device, with up to dev->max_in_flight of
+ * them in flight at the same time. Each message is replaced with its
+ * answer from the device.
+ *
+ * returns 0 or a negative error; if any request fails, -EPROTO
+ * is returned for HID++ errors.
+ */
+int hidpp20_request_commands(struct hidpp20_device *dev,
+			     union hidpp20_message *msgs,
+			     unsigned int count);
+
 #define CASE_RETURN_STRING(a) case a: return #a; break
 
 const char *hidpp20_feature_get_name(uint16_t feature);
@@ -84,6 +108,32 @@ struct hidpp20_device *
 hidpp20_device_new(const struct hidpp_device *base, unsigned int idx,
 		   struct hidpp_hid_report *reports, unsigned int num_reports);
 
+/**
+ * Same as hidpp20_device_new() but the feature list is not fetched from
+ * the device. The caller must call either hidpp20_device_init_features()
+ * or hidpp20_device_set_features() before using the device.
+ */
+struct hidpp20_device *
+hidpp20_device_new_uninitialized(const struct hidpp_device *base, unsigned int idx,
+				 struct hidpp_hid_report *reports, unsigned int num_reports);
+
+/**
+ * Fetches the feature list from the device.
+ *
+ * returns 0 or a negative error
+ */
+int
+hidpp20_device_init_features(struct hidpp20_device *device);
+
+/**
+ * Sets a feature list previously fetched from the same device, the list
+ * is copied.
+ */
+void
+hidpp20_device_set_features(struct hidpp20_device *device,
+			    const struct hidpp20_feature *features,
+			    unsigned int count);
+
 void
 hidpp20_device_destroy(struct hidpp20_device *device);
 
@@ -93,6 +143,18 @@ hidpp20_device_destroy(struct hidpp20_device *device);
 
 #define HIDPP_PAGE_ROOT					0x0000
 
+/**
+ * Looks up a feature in the feature list of the device, without any
+ * communication with the device.
+ *
+ * returns 0 or -ENOTSUP if the device doesn't have the feature
+ */
+int hidpp20_device_get_feature(struct hidpp20_device *device,
+			       uint16_t feature,
+			       uint8_t *feature_index,
+			       uint8_t *feature_type,
+			       uint8_t *feature_version);
+
 int hidpp_root_get_feature(struct hidpp20_device *device,
 			   uint16_t feature,
 			   uint8_t *feature_index,
@@ -113,6 +175,42 @@ int hidpp20_root_get_protocol_version(struct hidpp20_device *dev,
 
 #define HIDPP_PAGE_DEVICE_INFO				0x0003
 
+struct hidpp20_device_info {
+	uint8_t entity_count;
+	uint8_t unit_id[4];
+	uint8_t model_id[6];
+};
+
+#define HIDPP20_FW_TYPE_MAIN_APPLICATION		0x00
+
+struct hidpp20_fw_info {
+	uint8_t type;
+	char prefix[4];
+	uint8_t number;		/* BCD */
+	uint8_t revision;	/* BCD */
+	uint16_t build;		/* BCD */
+};
+
+/**
+ * Retrieves the device info. This does not require the feature list to
+ * be fetched first.
+ *
+ * returns 0 or a negative error
+ */
+int hidpp20_device_info_get_device_info(struct hidpp20_device *device,
+					struct hidpp20_device_info *info);
+
+/**
+ * Retrieves the firmware info of the given entity, entities are numbered
+ * from 0 to entity_count - 1. This does not require the feature list to
+ * be fetched first.
+ *
+ * returns 0 or a negative error
+ */
+int hidpp20_device_info_get_fw_info(struct hidpp20_device *device,
+				    uint8_t entity,
+				    struct hidpp20_fw_info *info);
+
 /* -------------------------------------------------------------------------- */
 /* 0x0005: Device Name                                                        */
 /* -------------------------------------------------------------------------- */
@@ -903,6 +1001,14 @@ struct hidpp20_onboard_profiles_info {
 } __attribute__((packed));
 _Static_assert(sizeof(struct hidpp20_onboard_profiles_info) == 16, "Invalid size");
 
+#define HIDPP20_SECTOR_CACHE_SIZE 8
+
+struct hidpp20_cached_sector {
+	uint16_t sector;
+	unsigned int last_used; /* 0 if the slot is unused */
+	uint8_t *data;
+};
+
 struct hidpp20_profiles {
 	uint8_t num_profiles;
 	uint8_t num_rom_profiles;
@@ -916,6 +1022,16 @@ struct hidpp20_profiles {
 	uint8_t sector_count;
 	uint16_t sector_size;
 	struct hidpp20_profile *profiles;
+
+	/* last content read from or written to the user sectors, sector 0
+	 * is the profile directory, sectors 1 to num_profiles the profiles */
+	uint8_t *shadow;
+	bool *shadow_valid;
+
+	/* least recently used copies of the other sectors we read, mostly
+	 * the ones holding the macros */
+	struct hidpp20_cached_sector sector_cache[HIDPP20_SECTOR_CACHE_SIZE];
+	unsigned int sector_cache_clock;
 };
 
 /**
@@ -1000,6 +1116,20 @@ hidpp20_onboard_profiles_read_sector(struct hidpp20_device *device,
 				     uint16_t sector_size,
 				     uint8_t *data);
 
+/**
+ * Reads count sectors in one batch of requests. The sectors are stored
+ * one after the other in data, which must be at least
+ * count * sector_size bytes long.
+ *
+ * returns 0 or a negative error.
+ */
+int
+hidpp20_onboard_profiles_read_sectors(struct hidpp20_device *device,
+				      const uint16_t *sectors,
+				      unsigned int count,
+				      uint16_t sector_size,
+				      uint8_t *data);
+
 int
 hidpp20_onboard_profiles_write_sector(struct hidpp20_device *device,
 				      uint16_t sector,
@@ -1007,6 +1137,18 @@ hidpp20_onboard_profiles_write_sector(struct hidpp20_device *device,
 				      uint8_t *data,
 				      bool write_crc);
 
+/**
+ * Checks that the shadow copies of the user sectors, e.g. restored from a
+ * cache, still match the content of the device. On mismatch or error
+ * all shadow copies are invalidated and will be read from the device.
+ *
+ * returns 0 if the shadow copies match, -ESTALE if they don't or a
+ * negative error.
+ */
+int
+hidpp20_onboard_profiles_verify_shadow(struct hidpp20_device *device,
+				       struct hidpp20_profiles *profiles);
+
 static inline uint8_t *
 hidpp20_onboard_profiles_allocate_sector(struct hidpp20_profiles *profiles)
 {
@@ -26,9 +26,14 @@
 #include <linux/input.h>
 
 #include <assert.h>
+#include <endian.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <glib.h>
 #include <limits.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "libratbag.h"
 #include "libratbag-private.h"
@@ -481,18 +486,435 @@ filter_device_files(const struct dirent *entry)
 	return streq(&name[len - slen], SUFFIX);
 }
 
-struct ratbag_device_data *
-ratbag_device_data_new_for_id(struct ratbag *ratbag, const struct input_id *id)
+/* The device index is compiled from the .device files at build time by
+ * data/devices/build-index.py, all integers are little endian:
+ *
+ *   struct device_index_header
+ *   struct device_index_entry[nentries], sorted by bustype, vendor, product
+ *   uint32_t[nfiles], offset of each file name from the start of the index
+ *   the NUL-terminated file names, sorted
+ */
+#define DEVICE_INDEX_FILE "devices.index"
+#define DEVICE_INDEX_MAGIC "RBDI"
+#define DEVICE_INDEX_VERSION 1
+
+struct device_index_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t nentries;
+	uint32_t nfiles;
+} __attribute__((packed));
+
+struct device_index_entry {
+	uint16_t bustype;
+	uint16_t vendor;
+	uint16_t product;
+	uint16_t file;
+} __attribute__((packed));
+
+struct ratbag_data_index {
+	char *datadir;
+	void *map;
+	size_t size;
+	const struct device_index_entry *entries;
+	uint32_t nentries;
+	const uint32_t *files;
+	uint32_t nfiles;
+};
+
+static const char *
+data_index_get_file(const struct ratbag_data_index *index, unsigned int idx)
+{
+	return (const char *)index->map + le32toh(index->files[idx]);
+}
+
+static bool
+data_index_has_file(const struct ratbag_data_index *index, const char *name)
+{
+	int lo = 0, hi = (int)index->nfiles - 1;
+
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(name, data_index_get_file(index, mid));
+
+		if (cmp == 0)
+			return true;
+		if (cmp < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+
+	return false;
+}
+
+/* The index is stale if a .device file was added, removed or modified
+ * after it was built */
+static bool
+data_index_is_current(const struct ratbag_data_index *index,
+		      const struct stat *st_index)
+{
+	struct dirent **files;
+	bool current = true;
+	int n, nfiles;
+
+	n = scandir(index->datadir, &files, filter_device_files, alphasort);
+	if (n < 0)
+		return false;
+
+	nfiles = n;
+	if ((uint32_t)nfiles != index->nfiles)
+		current = false;
+
+	while (current && n--) {
+		_cleanup_(freep) char *file = NULL;
+		struct stat st;
+
+		if (!data_index_has_file(index, files[n]->d_name) ||
+		    xasprintf(&file, "%s/%s", index->datadir, files[n]->d_name) == -1 ||
+		    stat(file, &st) < 0 ||
+		    st.st_mtime > st_index->st_mtime)
+			current = false;
+	}
+
+	while (nfiles--)
+		free(files[nfiles]);
+	free(files);
+
+	return current;
+}
+
+static void
+data_index_unmap(struct ratbag_data_index *index)
+{
+	if (index->map)
+		munmap(index->map, index->size);
+	index->map = NULL;
+	index->size = 0;
+}
+
+void
+ratbag_data_index_free(struct ratbag_data_index *index)
+{
+	if (!index)
+		return;
+
+	data_index_unmap(index);
+	free(index->datadir);
+	free(index);
+}
+
+/**
+ * Map the index in index->datadir, index->map stays NULL if there is no
+ * usable index.
+ */
+static void
+data_index_load(struct ratbag *ratbag, struct ratbag_data_index *index)
+{
+	_cleanup_(freep) char *path = NULL;
+	_cleanup_close_ int fd = -1;
+	const struct device_index_header *header;
+	struct stat st;
+	size_t size;
+	uint32_t i;
+
+	if (xasprintf(&path, "%s/%s", index->datadir, DEVICE_INDEX_FILE) == -1)
+		return;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) < 0)
+		return;
+
+	if ((size_t)st.st_size < sizeof(*header))
+		goto invalid;
+
+	index->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (index->map == MAP_FAILED) {
+		index->map = NULL;
+		return;
+	}
+	index->size = st.st_size;
+
+	header = index->map;
+	if (memcmp(header->magic, DEVICE_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+	    le32toh(header->version) != DEVICE_INDEX_VERSION)
+		goto invalid;
+
+	index->nentries = le32toh(header->nentries);
+	index->nfiles = le32toh(header->nfiles);
+
+	size = sizeof(*header) +
+	       (size_t)index->nentries * sizeof(*index->entries) +
+	       (size_t)index->nfiles * sizeof(*index->files);
+	if (size > index->size || ((const char *)index->map)[index->size - 1] != '\0')
+		goto invalid;
+
+	index->entries = (const void *)(header + 1);
+	index->files = (const void *)(index->entries + index->nentries);
+
+	for (i = 0; i < index->nentries; i++) {
+		if (le16toh(index->entries[i].file) >= index->nfiles)
+			goto invalid;
+	}
+	for (i = 0; i < index->nfiles; i++) {
+		uint32_t offset = le32toh(index->files[i]);
+
+		if (offset < size || offset >= index->size)
+			goto invalid;
+	}
+
+	if (!data_index_is_current(index, &st)) {
+		log_debug(ratbag, "Device index %s is stale\n", path);
+		data_index_unmap(index);
+		return;
+	}
+
+	log_debug(ratbag, "Using device index %s\n", path);
+	return;
+
+invalid:
+	log_error(ratbag, "Invalid device index %s\n", path);
+	data_index_unmap(index);
+}
+
+/* key is in host byte order, elem is an entry of the index */
+static int
+data_index_cmp_entry(const void *key, const void *elem)
+{
+	const struct device_index_entry *a = key, *b = elem;
+	uint16_t bustype = le16toh(b->bustype),
+		 vendor = le16toh(b->vendor),
+		 product = le16toh(b->product);
+
+	if (a->bustype != bustype)
+		return a->bustype < bustype ? -1 : 1;
+	if (a->vendor != vendor)
+		return a->vendor < vendor ? -1 : 1;
+	if (a->product != product)
+		return a->product < product ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Look up the id in the context's device index.
+ *
+ * @return 0 if the index is usable, with file set to the matching file
+ * name or NULL, or a negative errno if the data directory must be scanned
+ */
+static int
+data_index_lookup(struct ratbag *ratbag, const char *datadir,
+		  const struct input_id *id, const char **file)
+{
+	struct ratbag_data_index *index = ratbag->data_index;
+	const struct device_index_entry key = {
+		.bustype = id->bustype,
+		.vendor = id->vendor,
+		.product = id->product,
+	};
+	const struct device_index_entry *entry;
+
+	/* loaded once per context and data directory, a missing or stale
+	 * index is remembered as unmapped */
+	if (!index || !streq(index->datadir, datadir)) {
+		ratbag_data_index_free(index);
+		index = zalloc(sizeof(*index));
+		index->datadir = strdup_safe(datadir);
+		data_index_load(ratbag, index);
+		ratbag->data_index = index;
+	}
+
+	if (!index->map)
+		return -ENOENT;
+
+	entry = bsearch(&key, index->entries, index->nentries,
+			sizeof(*index->entries), data_index_cmp_entry);
+	*file = entry ? data_index_get_file(index, le16toh(entry->file)) : NULL;
+
+	return 0;
+}
+
+/* Parsed device data, including negative entries for unsupported ids, is
+ * kept per context until an inotify watch on the data directory reports
+ * a change */
+#define DATA_CACHE_BUCKETS 64
+
+struct data_cache_entry {
+	struct list link;
+	uint16_t bustype;
+	uint16_t vendor;
+	uint16_t product;
+	struct ratbag_device_data *data; /* NULL if no file matches */
+};
+
+struct ratbag_data_cache {
+	char *datadir;
+	int inotify_fd;
+	struct list buckets[DATA_CACHE_BUCKETS];
+};
+
+static struct list *
+data_cache_bucket(struct ratbag_data_cache *cache, const struct input_id *id)
+{
+	uint32_t key = ((uint32_t)id->vendor << 16 | id->product) ^ id->bustype;
+
+	return &cache->buckets[(key * 2654435761U) >> 26];
+}
+
+static void
+data_cache_flush(struct ratbag_data_cache *cache)
+{
+	struct data_cache_entry *entry, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < DATA_CACHE_BUCKETS; i++) {
+		list_for_each_safe(entry, tmp, &cache->buckets[i], link) {
+			list_remove(&entry->link);
+			ratbag_device_data_unref(entry->data);
+			free(entry);
+		}
+	}
+}
+
+void
+ratbag_data_cache_free(struct ratbag_data_cache *cache)
+{
+	if (!cache)
+		return;
+
+	data_cache_flush(cache);
+	safe_close(cache->inotify_fd);
+	free(cache->datadir);
+	free(cache);
+}
+
+static struct ratbag_data_cache *
+data_cache_new(struct ratbag *ratbag, const char *datadir)
+{
+	struct ratbag_data_cache *cache;
+	unsigned int i;
+	int wd;
+
+	cache = zalloc(sizeof(*cache));
+	cache->datadir = strdup_safe(datadir);
+	for (i = 0; i < DATA_CACHE_BUCKETS; i++)
+		list_init(&cache->buckets[i]);
+
+	/* without a watch we can't tell when the cache goes stale, so we
+	 * don't cache at all */
+	cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (cache->inotify_fd < 0)
+		return cache;
+
+	wd = inotify_add_watch(cache->inotify_fd, datadir,
+			       IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB |
+			       IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+			       IN_DELETE_SELF | IN_MOVE_SELF);
+	if (wd < 0) {
+		log_debug(ratbag, "Unable to watch %s, not caching device data: %s\n",
+			  datadir, strerror(errno));
+		cache->inotify_fd = safe_close(cache->inotify_fd);
+	}
+
+	return cache;
+}
+
+/**
+ * Drain the inotify events for the data directory.
+ *
+ * @return true if the directory changed since the last call
+ */
+static bool
+data_cache_changed(struct ratbag_data_cache *cache)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+
+	while (read(cache->inotify_fd, buf, sizeof(buf)) > 0)
+		changed = true;
+
+	return changed;
+}
+
+/**
+ * Get the context's cache for datadir, flushing it and the device index
+ * if the directory changed.
+ *
+ * @return the cache or NULL if caching isn't possible
+ */
+static struct ratbag_data_cache *
+data_cache_get(struct ratbag *ratbag, const char *datadir)
+{
+	struct ratbag_data_cache *cache = ratbag->data_cache;
+
+	if (!cache || !streq(cache->datadir, datadir)) {
+		ratbag_data_cache_free(cache);
+		cache = data_cache_new(ratbag, datadir);
+		ratbag->data_cache = cache;
+	}
+
+	if (cache->inotify_fd < 0)
+		return NULL;
+
+	if (data_cache_changed(cache)) {
+		log_debug(ratbag, "%s changed, flushing device data\n", datadir);
+		data_cache_flush(cache);
+		ratbag_data_index_free(ratbag->data_index);
+		ratbag->data_index = NULL;
+	}
+
+	return cache;
+}
+
+static struct data_cache_entry *
+data_cache_lookup(struct ratbag_data_cache *cache, const struct input_id *id)
+{
+	struct data_cache_entry *entry;
+
+	list_for_each(entry, data_cache_bucket(cache, id), link) {
+		if (entry->bustype == id->bustype &&
+		    entry->vendor == id->vendor &&
+		    entry->product == id->product)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void
+data_cache_insert(struct ratbag_data_cache *cache, const struct input_id *id,
+		  struct ratbag_device_data *data)
+{
+	struct data_cache_entry *entry;
+
+	entry = zalloc(sizeof(*entry));
+	entry->bustype = id->bustype;
+	entry->vendor = id->vendor;
+	entry->product = id->product;
+	entry->data = data ? ratbag_device_data_ref(data) : NULL;
+
+	list_insert(data_cache_bucket(cache, id), &entry->link);
+}
+
+static struct ratbag_device_data *
+device_data_find(struct ratbag *ratbag, const char *datadir,
+		 const struct input_id *id)
 {
 	struct ratbag_device_data *data = NULL;
 	struct dirent **files;
+	const char *indexed;
 	int n, nfiles;
-	const char *datadir;
 
-	datadir = getenv("LIBRATBAG_DATA_DIR");
-	if (!datadir)
-		datadir = LIBRATBAG_DATA_DIR;
-	log_debug(ratbag, "Using data directory '%s'\n", datadir);
+	if (data_index_lookup(ratbag, datadir, id, &indexed) == 0) {
+		_cleanup_(freep) char *file = NULL;
+
+		if (indexed &&
+		    xasprintf(&file, "%s/%s", datadir, indexed) != -1 &&
+		    file_data_matches(ratbag, file, id, &data))
+			return data;
+
+		log_debug(ratbag, "No data file found for %04x:%04x\n", id->vendor, id->product);
+		return NULL;
+	}
 
 	n = scandir(datadir, &files, filter_device_files, alphasort);
 	if (n <= 0) {
@@ -524,6 +946,33 @@ out:
 	return data;
 }
 
+struct ratbag_device_data *
+ratbag_device_data_new_for_id(struct ratbag *ratbag, const struct input_id *id)
+{
+	struct ratbag_data_cache *cache;
+	struct data_cache_entry *entry;
+	struct ratbag_device_data *data;
+	const char *datadir;
+
+	datadir = getenv("LIBRATBAG_DATA_DIR");
+	if (!datadir)
+		datadir = LIBRATBAG_DATA_DIR;
+	log_debug(ratbag, "Using data directory '%s'\n", datadir);
+
+	cache = data_cache_get(ratbag, datadir);
+	if (cache) {
+		entry = data_cache_lookup(cache, id);
+		if (entry)
+			return entry->data ? ratbag_device_data_ref(entry->data) : NULL;
+	}
+
+	data = device_data_find(ratbag, datadir, id);
+	if (cache)
+		data_cache_insert(cache, id, data);
+
+	return data;
+}
+
 
 /* HID++ 1.0 */
 
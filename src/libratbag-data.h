@@ -24,6 +24,8 @@
 #pragma once
 
 struct ratbag_device_data;
+struct ratbag_data_index;
+struct ratbag_data_cache;
 
 struct ratbag_device_data *
 ratbag_device_data_new_for_id(struct ratbag *ratbag, const struct input_id *id);
@@ -32,6 +34,12 @@ ratbag_device_data_new_for_id(struct ratbag *ratbag, const struct input_id *id);
 struct ratbag_device_data *
 ratbag_device_data_unref(struct ratbag_device_data *data);
 
+void
+ratbag_data_index_free(struct ratbag_data_index *index);
+
+void
+ratbag_data_cache_free(struct ratbag_data_cache *cache);
+
 struct ratbag_device_data *
 ratbag_device_data_ref(struct ratbag_device_data *data);
 
@@ -25,9 +25,11 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <glib.h>
 #include <poll.h>
 #include <libudev.h>
 #include <linux/hidraw.h>
+#include <linux/input.h>
 #include <string.h>
 
 #include "libratbag-hidraw.h"
@@ -45,10 +47,20 @@
 #define HID_MAX_BUFFER_SIZE	4096		/* 4kb */
 #endif
 
-#define HID_REPORT_ID		0b10000100
+#define HID_INPUT		0b10000000
+#define HID_OUTPUT		0b10010000
+#define HID_FEATURE		0b10110000
 #define HID_COLLECTION		0b10100000
 #define HID_USAGE_PAGE		0b00000100
+#define HID_REPORT_SIZE		0b01110100
+#define HID_REPORT_ID		0b10000100
+#define HID_REPORT_COUNT	0b10010100
+#define HID_PUSH		0b10100100
+#define HID_POP			0b10110100
 #define HID_USAGE		0b00001000
+#define HID_LONG_ITEM		0b11111110
+
+#define HID_GLOBAL_STACK_SIZE	8
 
 #define HID_PHYSICAL		0
 #define HID_APPLICATION		1
@@ -1179,6 +1191,37 @@ static const unsigned int hid_consumer_mapping[] = {
 	[HID_CC_AC_DISTRIBUTE_VERTICALLY		] = 0,
 };
 
+/* keycode to usage, filled from the tables above on first use */
+static uint8_t hid_keyboard_reverse_mapping[KEY_CNT];
+static uint16_t hid_consumer_reverse_mapping[KEY_CNT];
+
+static void
+ratbag_hidraw_init_reverse_mappings(void)
+{
+	static gsize initialized;
+	unsigned int j;
+
+	if (!g_once_init_enter(&initialized))
+		return;
+
+	_Static_assert(ARRAY_LENGTH(hid_keyboard_mapping) <= UINT8_MAX + 1, "usage too large");
+	_Static_assert(ARRAY_LENGTH(hid_consumer_mapping) <= UINT16_MAX + 1, "usage too large");
+
+	/* walk backwards so the lowest usage wins for keycodes that are
+	 * mapped more than once */
+	for (j = ARRAY_LENGTH(hid_keyboard_mapping); j-- > 0; ) {
+		assert(hid_keyboard_mapping[j] < KEY_CNT);
+		hid_keyboard_reverse_mapping[hid_keyboard_mapping[j]] = j;
+	}
+
+	for (j = ARRAY_LENGTH(hid_consumer_mapping); j-- > 0; ) {
+		assert(hid_consumer_mapping[j] < KEY_CNT);
+		hid_consumer_reverse_mapping[hid_consumer_mapping[j]] = j;
+	}
+
+	g_once_init_leave(&initialized, 1);
+}
+
 unsigned int
 ratbag_hidraw_get_keycode_from_keyboard_usage(struct ratbag_device *device,
 					      uint8_t hid_code)
@@ -1189,14 +1232,12 @@ ratbag_hidraw_get_keycode_from_keyboard_usage(struct ratbag_device *device,
 uint8_t
 ratbag_hidraw_get_keyboard_usage_from_keycode(struct ratbag_device *device, unsigned keycode)
 {
-	unsigned int j;
+	if (keycode >= KEY_CNT)
+		return 0;
 
-	for (j = 0; j < ARRAY_LENGTH(hid_keyboard_mapping); j++) {
-		if (hid_keyboard_mapping[j] == keycode)
-			return j;
-	}
+	ratbag_hidraw_init_reverse_mappings();
 
-	return 0;
+	return hid_keyboard_reverse_mapping[keycode];
 }
 
 unsigned int
@@ -1209,116 +1250,375 @@ ratbag_hidraw_get_keycode_from_consumer_usage(struct ratbag_device *device,
 uint16_t
 ratbag_hidraw_get_consumer_usage_from_keycode(struct ratbag_device *device, unsigned keycode)
 {
-	unsigned int j;
+	if (keycode >= KEY_CNT)
+		return 0;
 
-	for (j = 0; j < ARRAY_LENGTH(hid_consumer_mapping); j++) {
-		if (hid_consumer_mapping[j] == keycode)
-			return j;
-	}
+	ratbag_hidraw_init_reverse_mappings();
 
-	return 0;
+	return hid_consumer_reverse_mapping[keycode];
 }
 
+/* the global items we keep track of, saved and restored by push and pop */
+struct ratbag_hid_globals {
+	unsigned int usage_page;
+	unsigned int report_id;
+	unsigned int report_size;
+	unsigned int report_count;
+};
+
+/**
+ * Returns the index of the report with the given ID, adding it to the
+ * list if it is not there yet, or a negative errno.
+ */
 static int
-ratbag_hidraw_parse_report_descriptor(struct ratbag_device *device)
+ratbag_hidraw_find_or_add_report(struct ratbag_hidraw *hidraw,
+				 unsigned int *allocated,
+				 unsigned int report_id,
+				 unsigned int usage_page,
+				 unsigned int usage)
 {
-	int rc, desc_size = 0;
-	struct ratbag_hidraw *hidraw = &device->hidraw[0];
-	struct hidraw_report_descriptor report_desc = {0};
-	unsigned int i, j;
-	unsigned int usage_page, usage;
+	struct ratbag_hid_report *report;
+	unsigned int i;
 
-	hidraw->num_reports = 0;
+	for (i = 0; i < hidraw->num_reports; i++) {
+		if (hidraw->reports[i].report_id == report_id)
+			return i;
+	}
 
-	rc = ioctl(hidraw->fd, HIDIOCGRDESCSIZE, &desc_size);
-	if (rc < 0)
-		return rc;
+	if (hidraw->num_reports == *allocated) {
+		struct ratbag_hid_report *tmp;
 
-	report_desc.size = desc_size;
-	rc = ioctl(hidraw->fd, HIDIOCGRDESC, &report_desc);
-	if (rc < 0)
-		return rc;
+		tmp = realloc(hidraw->reports, 2 * *allocated * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+
+		memset(tmp + *allocated, 0, *allocated * sizeof(*tmp));
+		hidraw->reports = tmp;
+		*allocated *= 2;
+	}
 
-	log_debug(device->ratbag, "Parsing HID report descriptor\n");
+	report = &hidraw->reports[hidraw->num_reports];
+	memset(report, 0, sizeof(*report));
+	report->report_id = report_id;
+	report->usage_page = usage_page;
+	report->usage = usage;
+
+	return hidraw->num_reports++;
+}
+
+int
+ratbag_hidraw_parse_report_descriptor_data(struct ratbag *ratbag,
+					   struct ratbag_hidraw *hidraw,
+					   const uint8_t *data,
+					   size_t len)
+{
+	struct ratbag_hid_globals globals = {0};
+	struct ratbag_hid_globals stack[HID_GLOBAL_STACK_SIZE];
+	/* main items outside of any report ID, see the end of the loop */
+	struct ratbag_hid_report unnumbered = {0};
+	struct ratbag_hid_report *report;
+	unsigned int depth = 0;
+	unsigned int allocated = 1;
+	unsigned int i, j;
+	unsigned int usage;
+	int current = 0;
+
+	log_debug(ratbag, "Parsing HID report descriptor\n");
+
+	/* always allocate report 0 for devices without report IDs */
+	hidraw->num_reports = 0;
+	hidraw->reports = zalloc(allocated * sizeof(*hidraw->reports));
 
 	i = 0;
-	usage_page = 0;
 	usage = 0;
-	while (i < report_desc.size) {
-		uint8_t value = report_desc.value[i];
+	while (i < len) {
+		uint8_t value = data[i];
 		uint8_t hid = value & 0xfc;
 		uint8_t size = value & 0x3;
 		unsigned content = 0;
+		unsigned int bits;
+
+		if (value == HID_LONG_ITEM) {
+			/* bDataSize and bLongItemTag, then the data */
+			if (i + 2 >= len)
+				goto error;
+			i += 3 + data[i + 1];
+			continue;
+		}
 
 		if (size == 3)
 			size = 4;
 
-		if (i + size >= report_desc.size)
-			return -EPROTO;
+		if (i + size >= len)
+			goto error;
 
 		for (j = 0; j < size; j++)
-			content |= report_desc.value[i + j + 1] << (j * 8);
+			content |= data[i + j + 1] << (j * 8);
 
 		switch (hid) {
 		case HID_REPORT_ID:
-			if (hidraw->reports) {
-				log_debug(device->ratbag, "- HID report ID %02x\n", content);
-				hidraw->reports[hidraw->num_reports].report_id = content;
-				hidraw->reports[hidraw->num_reports].usage_page = usage_page;
-				hidraw->reports[hidraw->num_reports].usage = usage;
-			}
-			hidraw->num_reports++;
+			log_debug(ratbag, "- HID report ID %02x\n", content);
+			/* 0 is reserved, the items that follow are unnumbered */
+			globals.report_id = content;
+			if (content == 0)
+				break;
+			current = ratbag_hidraw_find_or_add_report(hidraw,
+								   &allocated,
+								   content,
+								   globals.usage_page,
+								   usage);
+			if (current < 0)
+				goto error;
 			break;
 		case HID_COLLECTION:
-			if (content == HID_APPLICATION &&
-			    hidraw->reports &&
-			    !hidraw->num_reports &&
-			    !hidraw->reports[0].report_id) {
-				hidraw->reports[hidraw->num_reports].usage_page = usage_page;
-				hidraw->reports[hidraw->num_reports].usage = usage;
+			if (content == HID_APPLICATION && !hidraw->num_reports) {
+				unnumbered.usage_page = globals.usage_page;
+				unnumbered.usage = usage;
 			}
 			break;
 		case HID_USAGE_PAGE:
-			usage_page = content;
+			globals.usage_page = content;
 			break;
 		case HID_USAGE:
 			usage = content;
 			break;
+		case HID_REPORT_SIZE:
+			globals.report_size = content;
+			break;
+		case HID_REPORT_COUNT:
+			globals.report_count = content;
+			break;
+		case HID_PUSH:
+			if (depth == ARRAY_LENGTH(stack))
+				goto error;
+			stack[depth++] = globals;
+			break;
+		case HID_POP:
+			if (depth == 0)
+				goto error;
+			globals = stack[--depth];
+			if (globals.report_id == 0)
+				break;
+			current = ratbag_hidraw_find_or_add_report(hidraw,
+								   &allocated,
+								   globals.report_id,
+								   globals.usage_page,
+								   usage);
+			if (current < 0)
+				goto error;
+			break;
+		case HID_INPUT:
+		case HID_OUTPUT:
+		case HID_FEATURE:
+			bits = globals.report_size * globals.report_count;
+			if (globals.report_id)
+				report = &hidraw->reports[current];
+			else
+				report = &unnumbered;
+			if (hid == HID_INPUT)
+				report->size_bits[HID_INPUT_REPORT] += bits;
+			else if (hid == HID_OUTPUT)
+				report->size_bits[HID_OUTPUT_REPORT] += bits;
+			else
+				report->size_bits[HID_FEATURE_REPORT] += bits;
+			break;
 		}
 
 		i += 1 + size;
 	}
 
+	/* Without report IDs the one report lives at index 0, outside of
+	 * num_reports. Items outside of any report ID in a descriptor
+	 * that does use them don't belong to any of its reports. */
+	if (hidraw->num_reports == 0)
+		hidraw->reports[0] = unnumbered;
+
 	return 0;
+
+error:
+	free(hidraw->reports);
+	hidraw->reports = NULL;
+	hidraw->num_reports = 0;
+
+	return -EPROTO;
 }
 
 static int
-ratbag_open_hidraw_node(struct ratbag_device *device, struct udev_device *hidraw_udev, int idx)
+ratbag_hidraw_parse_report_descriptor(struct ratbag_device *device,
+				      struct ratbag_hidraw *hidraw)
 {
-	struct hidraw_devinfo info;
-	struct ratbag_device *tmp_device;
-	int fd, res;
-	const char *devnode;
-	const char *sysname;
-	size_t reports_size;
+	struct hidraw_report_descriptor report_desc = {0};
+	int rc, desc_size = 0;
 
-	assert(idx >= 0 && idx < MAX_HIDRAW);
+	rc = ioctl(hidraw->fd, HIDIOCGRDESCSIZE, &desc_size);
+	if (rc < 0)
+		return rc;
 
-	device->hidraw[idx].fd = -1;
+	report_desc.size = desc_size;
+	rc = ioctl(hidraw->fd, HIDIOCGRDESC, &report_desc);
+	if (rc < 0)
+		return rc;
 
-	sysname = udev_device_get_sysname(hidraw_udev);
-	if (!strneq("hidraw", sysname, 6))
-		return -ENODEV;
+	return ratbag_hidraw_parse_report_descriptor_data(device->ratbag,
+							  hidraw,
+							  report_desc.value,
+							  report_desc.size);
+}
 
-	list_for_each(tmp_device, &device->ratbag->devices, link) {
-		if (tmp_device->hidraw[idx].sysname &&
-		    streq(tmp_device->hidraw[idx].sysname, sysname)) {
-			return -ENODEV;
+static struct ratbag_hidraw_endpoint *
+ratbag_hidraw_endpoint_get(struct ratbag_device *device,
+			   struct udev_device *hidraw_udev)
+{
+	struct ratbag_hidraw_endpoint *endpoint;
+	const char *sysname = udev_device_get_sysname(hidraw_udev);
+
+	list_for_each(endpoint, &device->hidraw_endpoints, link) {
+		if (streq(endpoint->hidraw.sysname, sysname))
+			return endpoint;
+	}
+
+	endpoint = zalloc(sizeof(*endpoint));
+	endpoint->devnode = strdup_safe(udev_device_get_devnode(hidraw_udev));
+	endpoint->hidraw.sysname = strdup_safe(sysname);
+	endpoint->hidraw.fd = -1;
+	list_insert(device->hidraw_endpoints.prev, &endpoint->link);
+
+	return endpoint;
+}
+
+static void
+ratbag_hidraw_endpoint_destroy(struct ratbag_device *device,
+			       struct ratbag_hidraw_endpoint *endpoint)
+{
+	if (endpoint->hidraw.fd >= 0)
+		ratbag_close_fd(device, endpoint->hidraw.fd);
+	free(endpoint->hidraw.reports);
+	free(endpoint->hidraw.sysname);
+	free(endpoint->devnode);
+	list_remove(&endpoint->link);
+	free(endpoint);
+}
+
+static bool
+ratbag_hidraw_endpoint_in_use(struct ratbag_device *device,
+			      struct ratbag_hidraw_endpoint *endpoint)
+{
+	int idx;
+
+	for (idx = 0; idx < MAX_HIDRAW; idx++) {
+		if (device->hidraw[idx].endpoint == endpoint)
+			return true;
+	}
+
+	return false;
+}
+
+/* Drops the input reports queued on the node, e.g. replies to what the
+ * previously probed driver sent, without waiting for more. */
+static void
+ratbag_hidraw_endpoint_drain(struct ratbag_device *device,
+			     struct ratbag_hidraw_endpoint *endpoint)
+{
+	uint8_t buf[HID_MAX_BUFFER_SIZE];
+	struct pollfd fds;
+	int rc;
+
+	fds.fd = endpoint->hidraw.fd;
+	fds.events = POLLIN;
+
+	while (poll(&fds, 1, 0) > 0) {
+		rc = read(fds.fd, buf, sizeof(buf));
+		if (rc <= 0)
+			break;
+
+		log_buf_raw(device->ratbag, "dropped report: ", buf, rc);
+	}
+}
+
+/* Records the hidraw nodes below the hid device or its usb parent, the
+ * nodes are not opened here. The walk is done once per device. */
+static struct ratbag_hidraw_scan *
+ratbag_hidraw_scan(struct ratbag_device *device, int use_usb_parent)
+{
+	struct ratbag *ratbag = device->ratbag;
+	struct ratbag_hidraw_scan *scan = &device->hidraw_scans[!!use_usb_parent];
+	_cleanup_(udev_enumerate_unrefp) struct udev_enumerate *e = NULL;
+	struct udev_list_entry *entry;
+	const char *path;
+	struct udev_device *hid_udev;
+	struct udev_device *parent_udev;
+	struct udev *udev = ratbag->udev;
+	size_t size = 0;
+
+	if (scan->done)
+		return scan;
+
+	hid_udev = udev_device_get_parent_with_subsystem_devtype(device->udev_device, "hid", NULL);
+
+	if (!hid_udev)
+		return NULL;
+
+	if (use_usb_parent && device->ids.bustype == BUS_USB) {
+		/* using the parent usb_device to match siblings */
+		parent_udev = udev_device_get_parent(hid_udev);
+		if (!streq("uhid", udev_device_get_sysname(parent_udev)))
+			parent_udev = udev_device_get_parent_with_subsystem_devtype(hid_udev,
+										    "usb",
+										    "usb_device");
+	} else {
+		parent_udev = hid_udev;
+	}
+
+	e = udev_enumerate_new(udev);
+	udev_enumerate_add_match_subsystem(e, "hidraw");
+	udev_enumerate_add_match_parent(e, parent_udev);
+	udev_enumerate_scan_devices(e);
+	udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(e)) {
+		_cleanup_(udev_device_unrefp) struct udev_device *udev_device = NULL;
+
+		path = udev_list_entry_get_name(entry);
+		udev_device = udev_device_new_from_syspath(udev, path);
+		if (!udev_device)
+			continue;
+
+		if (scan->count == size) {
+			size = size ? size * 2 : 4;
+			scan->endpoints = realloc(scan->endpoints,
+						  size * sizeof(*scan->endpoints));
+			if (!scan->endpoints)
+				abort();
 		}
+
+		scan->endpoints[scan->count++] = ratbag_hidraw_endpoint_get(device,
+									     udev_device);
 	}
 
-	devnode = udev_device_get_devnode(hidraw_udev);
-	fd = ratbag_open_path(device, devnode, O_RDWR);
+	scan->done = true;
+
+	return scan;
+}
+
+/* Opens the node and parses its report descriptor, only the first call
+ * does the work, later calls return the first result. */
+static int
+ratbag_hidraw_endpoint_open(struct ratbag_device *device,
+			    struct ratbag_hidraw_endpoint *endpoint)
+{
+	struct ratbag_hidraw *hidraw = &endpoint->hidraw;
+	struct hidraw_devinfo info;
+	int fd, res;
+
+	if (endpoint->opened)
+		return endpoint->status;
+
+	endpoint->opened = true;
+
+	if (!strneq("hidraw", hidraw->sysname, 6)) {
+		endpoint->status = -ENODEV;
+		return endpoint->status;
+	}
+
+	fd = ratbag_open_path(device, endpoint->devnode, O_RDWR);
 	if (fd < 0)
 		goto err;
 
@@ -1345,36 +1645,70 @@ ratbag_open_hidraw_node(struct ratbag_device *device, struct udev_device *hidraw
 	log_debug(device->ratbag,
 		  "%s is device '%s'.\n",
 		  device->name,
-		  udev_device_get_devnode(hidraw_udev));
+		  endpoint->devnode);
 
-	device->hidraw[idx].fd = fd;
+	hidraw->fd = fd;
 
-	/* parse first to count the number of reports */
-	res = ratbag_hidraw_parse_report_descriptor(device);
+	res = ratbag_hidraw_parse_report_descriptor(device, hidraw);
 	if (res) {
 		log_error(device->ratbag,
 			  "Error while parsing the report descriptor: '%s' (%d)\n",
 			  strerror(-res),
 			  res);
-		device->hidraw[idx].fd = -1;
+		hidraw->fd = -1;
+		errno = -res;
 		goto err;
 	}
 
-	if (device->hidraw[idx].num_reports)
-		reports_size = device->hidraw[idx].num_reports * sizeof(struct ratbag_hid_report);
-	else
-		reports_size = sizeof(struct ratbag_hid_report);
-
-	device->hidraw[idx].reports = zalloc(reports_size);
-	ratbag_hidraw_parse_report_descriptor(device);
-
-	device->hidraw[idx].sysname = strdup_safe(sysname);
+	endpoint->status = 0;
 	return 0;
 
 err:
+	endpoint->status = errno ? -errno : -ENODEV;
 	if (fd >= 0)
 		ratbag_close_fd(device, fd);
-	return -errno;
+	return endpoint->status;
+}
+
+static int
+ratbag_open_hidraw_node(struct ratbag_device *device,
+			struct ratbag_hidraw_endpoint *endpoint,
+			int idx)
+{
+	struct ratbag_device *tmp_device;
+	struct ratbag_hidraw *hidraw;
+	bool reused;
+	int rc;
+
+	assert(idx >= 0 && idx < MAX_HIDRAW);
+
+	hidraw = &device->hidraw[idx];
+	hidraw->fd = -1;
+	hidraw->endpoint = NULL;
+
+	list_for_each(tmp_device, &device->ratbag->devices, link) {
+		if (tmp_device->hidraw[idx].sysname &&
+		    streq(tmp_device->hidraw[idx].sysname,
+			  endpoint->hidraw.sysname)) {
+			return -ENODEV;
+		}
+	}
+
+	reused = endpoint->opened;
+	rc = ratbag_hidraw_endpoint_open(device, endpoint);
+	if (rc)
+		return rc;
+
+	if (reused)
+		ratbag_hidraw_endpoint_drain(device, endpoint);
+
+	hidraw->fd = endpoint->hidraw.fd;
+	hidraw->reports = endpoint->hidraw.reports;
+	hidraw->num_reports = endpoint->hidraw.num_reports;
+	hidraw->sysname = endpoint->hidraw.sysname;
+	hidraw->endpoint = endpoint;
+
+	return 0;
 }
 
 static int
@@ -1383,54 +1717,26 @@ ratbag_find_hidraw_node(struct ratbag_device *device,
 			int use_usb_parent,
 			int match_index, int hidraw_index)
 {
-	struct ratbag *ratbag = device->ratbag;
-	_cleanup_(udev_enumerate_unrefp) struct udev_enumerate *e = NULL;
-	struct udev_list_entry *entry;
-	const char *path;
-	struct udev_device *hid_udev;
-	struct udev_device *parent_udev;
-	struct udev *udev = ratbag->udev;
+	struct ratbag_hidraw_scan *scan;
 	int rc = -ENODEV;
-	int matched, endpoint_index = 0;
+	int matched;
+	size_t i;
 
 	assert(match);
 
-	hid_udev = udev_device_get_parent_with_subsystem_devtype(device->udev_device, "hid", NULL);
-
-	if (!hid_udev)
+	scan = ratbag_hidraw_scan(device, use_usb_parent);
+	if (!scan)
 		return -ENODEV;
 
-	if (use_usb_parent && device->ids.bustype == BUS_USB) {
-		/* using the parent usb_device to match siblings */
-		parent_udev = udev_device_get_parent(hid_udev);
-		if (!streq("uhid", udev_device_get_sysname(parent_udev)))
-			parent_udev = udev_device_get_parent_with_subsystem_devtype(hid_udev,
-										    "usb",
-										    "usb_device");
-	} else {
-		parent_udev = hid_udev;
-	}
-
-	e = udev_enumerate_new(udev);
-	udev_enumerate_add_match_subsystem(e, "hidraw");
-	udev_enumerate_add_match_parent(e, parent_udev);
-	udev_enumerate_scan_devices(e);
-	udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(e)) {
-		_cleanup_(udev_device_unrefp) struct udev_device *udev_device = NULL;
-
-		path = udev_list_entry_get_name(entry);
-		udev_device = udev_device_new_from_syspath(udev, path);
-		if (!udev_device)
+	for (i = 0; i < scan->count; i++) {
+		if (match_index > 0 && (size_t)match_index != i)
 			continue;
 
-		if (match_index > 0 && match_index != endpoint_index++)
-			continue;
-
-		rc = ratbag_open_hidraw_node(device, udev_device, hidraw_index);
+		rc = ratbag_open_hidraw_node(device, scan->endpoints[i],
+					     hidraw_index);
 		if (rc)
 			goto skip;
 
-
 		matched = match(device);
 		rc = matched ? 0 : -ENODEV;
 		if (matched == 1)
@@ -1443,6 +1749,40 @@ skip:
 	return rc;
 }
 
+void
+ratbag_hidraw_release_endpoints(struct ratbag_device *device, bool all)
+{
+	struct ratbag_hidraw_endpoint *endpoint, *tmp;
+	struct ratbag_hidraw_scan *scan;
+	int idx;
+
+	ARRAY_FOR_EACH(device->hidraw_scans, scan) {
+		free(scan->endpoints);
+		scan->endpoints = NULL;
+		scan->count = 0;
+		scan->done = false;
+	}
+
+	/* from now on an endpoint closes with the last slot using it */
+	device->hidraw_probed = true;
+
+	list_for_each_safe(endpoint, tmp, &device->hidraw_endpoints, link) {
+		if (!ratbag_hidraw_endpoint_in_use(device, endpoint)) {
+			ratbag_hidraw_endpoint_destroy(device, endpoint);
+			continue;
+		}
+
+		if (!all)
+			continue;
+
+		/* closing the last index using it destroys the endpoint */
+		for (idx = 0; idx < MAX_HIDRAW; idx++) {
+			if (device->hidraw[idx].endpoint == endpoint)
+				ratbag_close_hidraw_index(device, idx);
+		}
+	}
+}
+
 int
 ratbag_find_hidraw(struct ratbag_device *device, int (*match)(struct ratbag_device *device))
 {
@@ -1520,6 +1860,31 @@ ratbag_hidraw_get_usage(struct ratbag_device *device, unsigned int report_id)
 	return report->usage;
 }
 
+size_t
+ratbag_hidraw_get_report_length(struct ratbag_device *device,
+				unsigned int report_id,
+				unsigned char rtype)
+{
+	struct ratbag_hid_report *report;
+	unsigned int bits;
+
+	assert(rtype <= HID_FEATURE_REPORT);
+
+	if (device->hidraw[0].fd < 0 || !device->hidraw[0].reports)
+		return 0;
+
+	report = ratbag_hidraw_get_report(device, report_id);
+	if (!report)
+		return 0;
+
+	bits = report->size_bits[rtype];
+	if (bits == 0)
+		return 0;
+
+	/* the buffer always starts with the report ID, even if it's 0 */
+	return 1 + (bits + 7) / 8;
+}
+
 void
 ratbag_close_hidraw(struct ratbag_device *device)
 {
@@ -1534,6 +1899,23 @@ ratbag_close_hidraw_index(struct ratbag_device *device, int idx)
 	if (device->hidraw[idx].fd < 0)
 		return;
 
+	/* while probing, the endpoint keeps the node open for the next
+	 * driver, ratbag_hidraw_release_endpoints() closes it afterwards */
+	if (device->hidraw[idx].endpoint) {
+		struct ratbag_hidraw_endpoint *endpoint = device->hidraw[idx].endpoint;
+
+		device->hidraw[idx].endpoint = NULL;
+		device->hidraw[idx].sysname = NULL;
+		device->hidraw[idx].reports = NULL;
+		device->hidraw[idx].num_reports = 0;
+		device->hidraw[idx].fd = -1;
+
+		if (device->hidraw_probed &&
+		    !ratbag_hidraw_endpoint_in_use(device, endpoint))
+			ratbag_hidraw_endpoint_destroy(device, endpoint);
+		return;
+	}
+
 	if (device->hidraw[idx].sysname) {
 		free(device->hidraw[idx].sysname);
 		device->hidraw[idx].sysname = NULL;
@@ -1548,11 +1930,33 @@ ratbag_close_hidraw_index(struct ratbag_device *device, int idx)
 	}
 }
 
+/* Reads the feature report straight into buf, the report ID is
+ * overwritten even if the request fails. */
+static int
+ratbag_hidraw_get_feature(struct ratbag_device *device, unsigned char reportnum,
+			  uint8_t *buf, size_t len, size_t report_len)
+{
+	int rc;
+
+	if (report_len)
+		len = min(len, report_len);
+
+	buf[0] = reportnum;
+
+	rc = ioctl(device->hidraw[0].fd, HIDIOCGFEATURE(len), buf);
+	if (rc < 0)
+		return -errno;
+
+	log_buf_raw(device->ratbag, "feature get:   ", buf, (unsigned)rc);
+
+	return rc;
+}
+
 int
 ratbag_hidraw_raw_request(struct ratbag_device *device, unsigned char reportnum,
 			  uint8_t *buf, size_t len, unsigned char rtype, int reqtype)
 {
-	uint8_t tmp_buf[HID_MAX_BUFFER_SIZE];
+	size_t report_len;
 	int rc;
 
 	if (len < 1 || len > HID_MAX_BUFFER_SIZE || !buf || device->hidraw[0].fd < 0)
@@ -1561,20 +1965,21 @@ ratbag_hidraw_raw_request(struct ratbag_device *device, unsigned char reportnum,
 	if (rtype != HID_FEATURE_REPORT)
 		return -ENOTSUP;
 
+	/* 0 if the descriptor doesn't tell, we trust the caller then */
+	report_len = ratbag_hidraw_get_report_length(device, reportnum, rtype);
+
 	switch (reqtype) {
 	case HID_REQ_GET_REPORT:
-		memset(tmp_buf, 0, len);
-		tmp_buf[0] = reportnum;
-
-		rc = ioctl(device->hidraw[0].fd, HIDIOCGFEATURE(len), tmp_buf);
-		if (rc < 0)
-			return -errno;
-
-		log_buf_raw(device->ratbag, "feature get:   ", tmp_buf, (unsigned)rc);
-
-		memcpy(buf, tmp_buf, rc);
-		return rc;
+		return ratbag_hidraw_get_feature(device, reportnum, buf, len,
+						 report_len);
 	case HID_REQ_SET_REPORT:
+		if (report_len && len > report_len) {
+			log_error(device->ratbag,
+				  "feature report 0x%02x is %zu bytes, refusing to send %zu\n",
+				  reportnum, report_len, len);
+			return -EINVAL;
+		}
+
 		buf[0] = reportnum;
 
 		log_buf_raw(device->ratbag, "feature set:   ", buf, len);
@@ -1604,15 +2009,56 @@ ratbag_hidraw_set_feature_report(struct ratbag_device *device, unsigned char rep
 					 HID_FEATURE_REPORT, HID_REQ_SET_REPORT);
 }
 
+int
+ratbag_hidraw_get_feature_reports(struct ratbag_device *device,
+				  struct ratbag_hidraw_feature_request *requests,
+				  size_t count)
+{
+	int rc = 0;
+
+	if (device->hidraw[0].fd < 0)
+		return -EINVAL;
+
+	for (size_t i = 0; i < count; i++) {
+		struct ratbag_hidraw_feature_request *r = &requests[i];
+		size_t report_len;
+
+		if (r->len < 1 || r->len > HID_MAX_BUFFER_SIZE || !r->buf) {
+			r->rc = -EINVAL;
+		} else {
+			report_len = ratbag_hidraw_get_report_length(device,
+								     r->reportnum,
+								     HID_FEATURE_REPORT);
+			r->rc = ratbag_hidraw_get_feature(device, r->reportnum,
+							  r->buf, r->len,
+							  report_len);
+		}
+
+		if (r->rc < 0 && rc == 0)
+			rc = r->rc;
+	}
+
+	return rc;
+}
+
 
 int
 ratbag_hidraw_output_report(struct ratbag_device *device, uint8_t *buf, size_t len)
 {
+	size_t report_len;
 	int rc;
 
 	if (len < 1 || len > HID_MAX_BUFFER_SIZE || !buf || device->hidraw[0].fd < 0)
 		return -EINVAL;
 
+	report_len = ratbag_hidraw_get_report_length(device, buf[0], HID_OUTPUT_REPORT);
+	if (report_len && len > report_len) {
+		log_error(device->ratbag,
+			  "output report 0x%02x is %zu bytes, refusing to send %zu\n",
+			  buf[0], report_len, len);
+		return -EINVAL;
+	}
+
 	log_buf_raw(device->ratbag, "output report: ", buf, len);
 
 	rc = write(device->hidraw[0].fd, buf, len);
@@ -1646,7 +2092,7 @@ ratbag_hidraw_read_input_report_index(struct ratbag_device *device, uint8_t *buf
 	fds.fd = device->hidraw[hidrawno].fd;
 	fds.events = POLLIN;
 
-	rc = poll(&fds, 1, 1000);
+	rc = poll(&fds, 1, RATBAG_HIDRAW_TIMEOUT_MS);
 	if (rc == -1)
 		return -errno;
 
@@ -1660,3 +2106,4 @@ ratbag_hidraw_read_input_report_index(struct ratbag_device *device, uint8_t *buf
 
 	return rc >= 0 ? rc : -errno;
 }
+
@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 #include "libratbag.h"
+#include "libratbag-util.h"
 
 /* defined in the internal hid API in the kernel */
 #define HID_INPUT_REPORT	0
@@ -34,10 +35,16 @@
 #define HID_FEATURE_REPORT	2
 #define MAX_HIDRAW 2
 
+/* default time to wait for an input report, in ms */
+#define RATBAG_HIDRAW_TIMEOUT_MS 1000
+
 struct ratbag_hid_report {
 	unsigned int report_id;
 	unsigned int usage_page;
 	unsigned int usage;
+	/* the payload size in bits, indexed by HID_INPUT_REPORT,
+	 * HID_OUTPUT_REPORT and HID_FEATURE_REPORT */
+	unsigned int size_bits[3];
 };
 
 struct ratbag_hidraw {
@@ -45,6 +52,32 @@ struct ratbag_hidraw {
 	struct ratbag_hid_report *reports;
 	unsigned num_reports;
 	char *sysname;
+	/* the pool endpoint that owns fd, reports and sysname, if any */
+	struct ratbag_hidraw_endpoint *endpoint;
+};
+
+/**
+ * A hidraw node found while walking udev for a device. The node is only
+ * opened and its report descriptor parsed the first time a driver asks
+ * for it, the result is kept so that the drivers probed one after the
+ * other don't repeat that work.
+ */
+struct ratbag_hidraw_endpoint {
+	struct list link;
+	char *devnode;
+	bool opened; /* true once open and parse were attempted */
+	int status; /* 0 or the negative errno of the attempt */
+	struct ratbag_hidraw hidraw; /* fd, reports and sysname */
+};
+
+/**
+ * The endpoints of one udev walk, in enumeration order. Walks starting
+ * from the hid device and from its usb parent give different lists.
+ */
+struct ratbag_hidraw_scan {
+	bool done;
+	struct ratbag_hidraw_endpoint **endpoints;
+	size_t count;
 };
 
 /**
@@ -96,6 +129,37 @@ void ratbag_close_hidraw(struct ratbag_device *device);
  */
 void ratbag_close_hidraw_index(struct ratbag_device *device, int idx);
 
+/**
+ * Parse a HID report descriptor into the reports of hidraw. Descriptors
+ * without report IDs have their one report at index 0 with num_reports
+ * 0, otherwise the reports are in the order their IDs first appear.
+ *
+ * @param ratbag the ratbag context, used for logging
+ * @param hidraw the hidraw device to fill in
+ * @param data the report descriptor
+ * @param len length of data
+ *
+ * @return 0 on success or -EPROTO if the descriptor is malformed
+ */
+int
+ratbag_hidraw_parse_report_descriptor_data(struct ratbag *ratbag,
+					   struct ratbag_hidraw *hidraw,
+					   const uint8_t *data,
+					   size_t len);
+
+/**
+ * Release the hidraw endpoints found for the device. Endpoints still in
+ * use by one of the device's hidraw indices are kept unless all is true.
+ *
+ * This is called once the driver is assigned, the endpoints are only
+ * worth keeping around while drivers are probed. From then on, closing
+ * the last hidraw index that uses an endpoint closes the endpoint too.
+ *
+ * @param device the ratbag device
+ * @param all true to release the endpoints in use as well
+ */
+void ratbag_hidraw_release_endpoints(struct ratbag_device *device, bool all);
+
 /**
  * Send report request to device
  *
@@ -149,6 +213,30 @@ int ratbag_hidraw_get_feature_report(struct ratbag_device *device, unsigned char
  */
 int ratbag_hidraw_set_feature_report(struct ratbag_device *device, unsigned char reportnum,
 				     uint8_t *buf, size_t len);
+
+struct ratbag_hidraw_feature_request {
+	unsigned char reportnum;
+	uint8_t *buf;
+	size_t len;
+	int rc; /* set to the count of data read or a negative errno */
+};
+
+/**
+ * Get several feature reports from the device in one call.
+ *
+ * Each report is read straight into its buffer, like
+ * ratbag_hidraw_get_feature_report(). All requests are issued even if
+ * one of them fails, the result of each is stored in its rc field.
+ *
+ * @param device the ratbag device
+ * @param requests the reports to fetch
+ * @param count the number of requests
+ *
+ * @return 0 if all reports were read, or the first negative errno
+ */
+int ratbag_hidraw_get_feature_reports(struct ratbag_device *device,
+				      struct ratbag_hidraw_feature_request *requests,
+				      size_t count);
 /**
  * Send output report to device
  *
@@ -219,6 +307,23 @@ ratbag_hidraw_get_usage_page(struct ratbag_device *device, unsigned int report_i
 unsigned int
 ratbag_hidraw_get_usage(struct ratbag_device *device, unsigned int report_id);
 
+/**
+ * Gives the length of a report as declared by the report descriptor. The
+ * length includes the leading report ID byte, i.e. it is the buffer size
+ * for ratbag_hidraw_raw_request() and ratbag_hidraw_output_report().
+ *
+ * @param device the ratbag device which hidraw node is opened
+ * @param report_id the report ID we inquire about
+ * @param rtype HID_INPUT_REPORT, HID_OUTPUT_REPORT or HID_FEATURE_REPORT
+ *
+ * @return the length of the report in bytes, or 0 if the device doesn't
+ * have a report of this type with the given report id
+ */
+size_t
+ratbag_hidraw_get_report_length(struct ratbag_device *device,
+				unsigned int report_id,
+				unsigned char rtype);
+
 /**
  * Gives the input key code associated to the keyboard HID usage.
  *
@@ -124,6 +124,9 @@ struct ratbag {
 	int refcount;
 	ratbag_log_handler log_handler;
 	enum ratbag_log_priority log_priority;
+
+	struct ratbag_data_index *data_index;
+	struct ratbag_data_cache *data_cache;
 };
 
 #define MAX_CAP 1000
@@ -134,6 +137,10 @@ struct ratbag_device {
 
 	struct udev_device *udev_device;
 	struct ratbag_hidraw hidraw[MAX_HIDRAW];
+	/* the hidraw nodes found so far, shared by the drivers probed */
+	struct list hidraw_endpoints;
+	struct ratbag_hidraw_scan hidraw_scans[2]; /* hid and usb parent */
+	bool hidraw_probed; /* endpoints close once no slot uses them */
 	int refcount;
 	struct input_id ids;
 	struct ratbag_driver *driver;
@@ -148,6 +155,17 @@ struct ratbag_device {
 
 	void *drv_data;
 
+	/* the open transaction, if any */
+	struct ratbag_transaction *transaction;
+
+	/* the macro events used by the buttons, identical macros share
+	 * their events */
+	struct list macro_pool;
+
+	/* the DPI lists of the resolutions, shared between all resolutions
+	 * with the same list */
+	struct list dpi_lists;
+
 	struct list link;
 };
 
@@ -193,6 +211,10 @@ struct ratbag_driver {
 	 * the last commit. In order to reduce the amount of time
 	 * committing takes, drivers should use this information to avoid
 	 * writing back profiles and buttons that haven't actually changed.
+	 *
+	 * Changes made in a transaction are validated before and arrive
+	 * here as a single set, with objects that ended up unchanged
+	 * already filtered out.
 	 */
 	int (*commit)(struct ratbag_device *device);
 
@@ -211,6 +233,16 @@ struct ratbag_driver {
 	 */
 	int (*set_active_profile)(struct ratbag_device *device, unsigned int index);
 
+	/**
+	 * Callback called the first time the macro of a button with
+	 * macro_pending set is needed.
+	 *
+	 * The driver should read the macro from the device and assign it
+	 * with ratbag_button_copy_macro(). Drivers that read all macros in
+	 * probe don't need to implement this.
+	 */
+	int (*read_button_macro)(struct ratbag_button *button);
+
 	/*
 	 * FIXME: This function is deprecated and should be removed. Once
 	 * we've updated all the device drivers to stop using it we'll remove
@@ -242,6 +274,30 @@ struct ratbag_driver {
 	struct list link;
 };
 
+/**
+ * A run of evenly spaced DPI values, min and max included. The step is 0
+ * if the band holds only one value.
+ */
+struct ratbag_dpi_band {
+	unsigned int min;
+	unsigned int max;
+	unsigned int step;
+	unsigned int index; /**< position of min in the whole list */
+};
+
+/**
+ * The DPI values supported by a resolution in ascending order, stored as
+ * bands. Refcounted and shared between resolutions, never modified once
+ * assigned to a resolution.
+ */
+struct ratbag_dpi_list {
+	int refcount;
+	struct list link; /* ratbag_device->dpi_lists */
+	unsigned int ndpis;
+	unsigned int nbands;
+	struct ratbag_dpi_band bands[];
+};
+
 struct ratbag_resolution {
 	struct ratbag_profile *profile;
 	int refcount;
@@ -249,8 +305,7 @@ struct ratbag_resolution {
 	struct list link;
 	unsigned index;
 
-	unsigned int dpis[300];
-	size_t ndpis;
+	struct ratbag_dpi_list *dpis; /* NULL if unset */
 
 	unsigned int dpi_x;	/**< x resolution in dpi */
 	unsigned int dpi_y;	/**< y resolution in dpi */
@@ -340,13 +395,59 @@ struct ratbag_macro_event {
 	} event;
 };
 
+/**
+ * The events of a macro. Those are shared between all macros with the
+ * same content and never modified while shared, use
+ * ratbag_macro_set_event() to change a macro.
+ */
+struct ratbag_macro_events {
+	int refcount;
+	struct list link; /* ratbag_device->macro_pool */
+	unsigned int count;
+	unsigned int capacity;
+	struct ratbag_macro_event events[];
+};
+
 #define MAX_MACRO_EVENTS 256
 struct ratbag_macro {
 	char *name;
 	char *group;
-	struct ratbag_macro_event events[MAX_MACRO_EVENTS];
+	struct ratbag_macro_events *events; /* NULL if empty */
 };
 
+static inline unsigned int
+ratbag_macro_get_num_events(const struct ratbag_macro *macro)
+{
+	return macro->events ? macro->events->count : 0;
+}
+
+/**
+ * Returns the event at the given index, events past the end of the macro
+ * are RATBAG_MACRO_EVENT_NONE.
+ */
+static inline struct ratbag_macro_event
+ratbag_macro_get_event(const struct ratbag_macro *macro, unsigned int index)
+{
+	struct ratbag_macro_event none = { .type = RATBAG_MACRO_EVENT_NONE };
+
+	if (index >= ratbag_macro_get_num_events(macro))
+		return none;
+
+	return macro->events->events[index];
+}
+
+void
+ratbag_macro_set_event(struct ratbag_macro *macro,
+		       unsigned int index,
+		       const struct ratbag_macro_event *event);
+
+bool
+ratbag_macro_has_same_events(const struct ratbag_macro *a,
+			     const struct ratbag_macro *b);
+
+void
+ratbag_macro_events_unref(struct ratbag_macro_events *events);
+
 struct ratbag_button_macro {
 	int refcount;
 	struct ratbag_macro macro;
@@ -384,6 +485,9 @@ struct ratbag_button {
 	struct ratbag_button_action action;
 	uint32_t action_caps;
 	bool dirty; /* changed since last commit to device */
+	/* the action is a macro that hasn't been read from the device yet,
+	 * see ratbag_driver.read_button_macro() */
+	bool macro_pending;
 };
 
 void
@@ -497,59 +601,33 @@ ratbag_resolution_set_resolution(struct ratbag_resolution *res,
 	res->dpi_y = dpi_y;
 }
 
-static inline void
+void
 ratbag_resolution_set_dpi_list_from_range(struct ratbag_resolution *res,
-					  unsigned int min, unsigned int max)
-{
-	unsigned int stepsize = 50;
-	unsigned int dpi = min;
-	bool maxed_out = false;
-
-	res->ndpis = 0;
-
-	while (res->ndpis < ARRAY_LENGTH(res->dpis)) {
-		if (dpi > (unsigned)max) {
-			maxed_out = true;
-			break;
-		}
-
-		res->dpis[res->ndpis] = dpi;
-		res->ndpis++;
-
-		if (dpi < 1000)
-			stepsize = 50;
-		else if (dpi < 2600)
-			stepsize = 100;
-		else if (dpi < 5000)
-			stepsize = 200;
-		else
-			stepsize = 500;
-
-		dpi += stepsize;
-	}
+					  unsigned int min, unsigned int max);
 
-	if (!maxed_out)
-		log_bug_libratbag(res->profile->device->ratbag,
-				  "%s: resolution range exceeds available space.\n",
-				  res->profile->device->name);
-}
-
-static inline void
+void
 ratbag_resolution_set_dpi_list(struct ratbag_resolution *res,
 			       unsigned int *dpis,
-			       size_t ndpis)
-{
-	assert(ndpis <= ARRAY_LENGTH(res->dpis));
-	_Static_assert(sizeof(*dpis) == sizeof(*res->dpis), "Mismatching size");
+			       size_t ndpis);
 
-	for (size_t i = 0; i < ndpis; i++) {
-		res->dpis[i] = dpis[i];
-		if (i > 0)
-			assert(dpis[i] > dpis[i - 1]);
-	}
-	res->ndpis = ndpis;
+static inline size_t
+ratbag_resolution_get_num_dpis(const struct ratbag_resolution *res)
+{
+	return res->dpis ? res->dpis->ndpis : 0;
 }
 
+bool
+ratbag_resolution_has_dpi(const struct ratbag_resolution *res,
+			  unsigned int dpi);
+
+/**
+ * Returns the index of dpi in the resolution's DPI list or -1 if the
+ * resolution doesn't support it.
+ */
+int
+ratbag_resolution_get_dpi_index(const struct ratbag_resolution *res,
+				unsigned int dpi);
+
 static inline void
 ratbag_profile_set_report_rate_list(struct ratbag_profile *profile,
 				    unsigned int *rates,
@@ -617,3 +695,6 @@ void
 ratbag_button_copy_macro(struct ratbag_button *button,
 			 const struct ratbag_button_macro *macro);
 
+
+enum ratbag_error_code
+ratbag_device_write_changes(struct ratbag_device *device);
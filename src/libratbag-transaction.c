@@ -0,0 +1,524 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Transactions keep a copy of the device state from when they were
+ * opened. The setters keep working on the live objects, so the drivers
+ * need no changes; on commit the copy tells us which objects actually
+ * changed. Only those are validated, and only those stay dirty for the
+ * driver's commit hook.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libratbag.h"
+#include "libratbag-private.h"
+#include "libratbag-util.h"
+
+struct ratbag_transaction_resolution {
+	unsigned int dpi_x, dpi_y;
+	bool is_active;
+	bool is_default;
+	bool dirty;
+};
+
+struct ratbag_transaction_button {
+	struct ratbag_button_action action;
+	struct ratbag_button_macro *macro;
+	bool macro_pending;
+	bool dirty;
+};
+
+struct ratbag_transaction_led {
+	enum ratbag_led_mode mode;
+	struct ratbag_color color;
+	unsigned int ms;
+	unsigned int brightness;
+	bool dirty;
+};
+
+struct ratbag_transaction_profile {
+	char *name;
+	unsigned int hz;
+	bool is_enabled;
+	bool dirty;
+	bool rate_dirty;
+
+	struct ratbag_transaction_resolution *resolutions;
+	struct ratbag_transaction_button *buttons;
+	struct ratbag_transaction_led *leds;
+};
+
+struct ratbag_transaction {
+	struct ratbag_device *device;
+	struct ratbag_transaction_profile *profiles;
+};
+
+/* All walks below go through the device's lists in the same order as
+ * ratbag_device_begin_transaction() did, so the n-th saved entry always
+ * belongs to the n-th object. */
+
+static void
+transaction_save_button(struct ratbag_transaction_button *saved,
+			struct ratbag_button *button)
+{
+	saved->action = button->action;
+	saved->action.macro = NULL;
+	saved->dirty = button->dirty;
+	saved->macro_pending = button->macro_pending;
+
+	/* don't read a macro from the device just to save it, the restored
+	 * button will simply read it again */
+	if (button->action.type == RATBAG_BUTTON_ACTION_TYPE_MACRO &&
+	    !button->macro_pending) {
+		saved->macro = ratbag_button_get_macro(button);
+		if (saved->macro)
+			saved->macro->macro.group = strdup_safe(button->action.macro->group);
+	}
+}
+
+static void
+transaction_save_profile(struct ratbag_transaction_profile *saved,
+			 struct ratbag_profile *profile)
+{
+	struct ratbag_device *device = profile->device;
+	struct ratbag_resolution *resolution;
+	struct ratbag_button *button;
+	struct ratbag_led *led;
+	unsigned int i;
+
+	saved->name = strdup_safe(profile->name);
+	saved->hz = profile->hz;
+	saved->is_enabled = profile->is_enabled;
+	saved->dirty = profile->dirty;
+	saved->rate_dirty = profile->rate_dirty;
+
+	saved->resolutions = zalloc(profile->num_resolutions *
+				    sizeof(*saved->resolutions));
+	i = 0;
+	ratbag_profile_for_each_resolution(profile, resolution) {
+		struct ratbag_transaction_resolution *r = &saved->resolutions[i++];
+
+		r->dpi_x = resolution->dpi_x;
+		r->dpi_y = resolution->dpi_y;
+		r->is_active = resolution->is_active;
+		r->is_default = resolution->is_default;
+		r->dirty = resolution->dirty;
+	}
+
+	saved->buttons = zalloc(device->num_buttons * sizeof(*saved->buttons));
+	i = 0;
+	ratbag_profile_for_each_button(profile, button)
+		transaction_save_button(&saved->buttons[i++], button);
+
+	saved->leds = zalloc(device->num_leds * sizeof(*saved->leds));
+	i = 0;
+	ratbag_profile_for_each_led(profile, led) {
+		struct ratbag_transaction_led *l = &saved->leds[i++];
+
+		l->mode = led->mode;
+		l->color = led->color;
+		l->ms = led->ms;
+		l->brightness = led->brightness;
+		l->dirty = led->dirty;
+	}
+}
+
+static void
+transaction_free(struct ratbag_transaction *transaction)
+{
+	struct ratbag_device *device = transaction->device;
+	unsigned int i, j;
+
+	for (i = 0; i < device->num_profiles; i++) {
+		struct ratbag_transaction_profile *p = &transaction->profiles[i];
+
+		for (j = 0; j < device->num_buttons; j++)
+			ratbag_button_macro_unref(p->buttons[j].macro);
+
+		free(p->name);
+		free(p->resolutions);
+		free(p->buttons);
+		free(p->leds);
+	}
+
+	device->transaction = NULL;
+	ratbag_device_unref(device);
+	free(transaction->profiles);
+	free(transaction);
+}
+
+LIBRATBAG_EXPORT struct ratbag_transaction *
+ratbag_device_begin_transaction(struct ratbag_device *device)
+{
+	struct ratbag_transaction *transaction;
+	struct ratbag_profile *profile;
+	unsigned int i = 0;
+
+	if (device->transaction) {
+		log_bug_client(device->ratbag,
+			       "%s: a transaction is already open\n",
+			       device->name);
+		return NULL;
+	}
+
+	transaction = zalloc(sizeof(*transaction));
+	transaction->device = ratbag_device_ref(device);
+	transaction->profiles = zalloc(device->num_profiles *
+				       sizeof(*transaction->profiles));
+
+	ratbag_device_for_each_profile(device, profile)
+		transaction_save_profile(&transaction->profiles[i++], profile);
+
+	device->transaction = transaction;
+
+	return transaction;
+}
+
+static bool
+transaction_macro_changed(const struct ratbag_button_macro *saved,
+			  const struct ratbag_macro *macro)
+{
+	if (!saved || !macro)
+		return true;
+
+	return !streq_ptr(saved->macro.name, macro->name) ||
+	       !streq_ptr(saved->macro.group, macro->group) ||
+	       !ratbag_macro_has_same_events(&saved->macro, macro);
+}
+
+static bool
+transaction_button_changed(const struct ratbag_transaction_button *saved,
+			   const struct ratbag_button *button)
+{
+	if (saved->action.type != button->action.type)
+		return true;
+
+	switch (button->action.type) {
+	case RATBAG_BUTTON_ACTION_TYPE_MACRO:
+		if (saved->macro_pending)
+			return !button->macro_pending;
+		return transaction_macro_changed(saved->macro,
+						 button->action.macro);
+	case RATBAG_BUTTON_ACTION_TYPE_BUTTON:
+	case RATBAG_BUTTON_ACTION_TYPE_SPECIAL:
+	case RATBAG_BUTTON_ACTION_TYPE_KEY:
+		return !ratbag_button_action_match(&saved->action,
+						   &button->action);
+	default:
+		/* no payload to compare */
+		return false;
+	}
+}
+
+static bool
+transaction_led_changed(const struct ratbag_transaction_led *saved,
+			const struct ratbag_led *led)
+{
+	return saved->mode != led->mode ||
+	       saved->color.red != led->color.red ||
+	       saved->color.green != led->color.green ||
+	       saved->color.blue != led->color.blue ||
+	       saved->ms != led->ms ||
+	       saved->brightness != led->brightness;
+}
+
+static bool
+transaction_resolution_changed(const struct ratbag_transaction_resolution *saved,
+			       const struct ratbag_resolution *resolution)
+{
+	return saved->dpi_x != resolution->dpi_x ||
+	       saved->dpi_y != resolution->dpi_y ||
+	       saved->is_active != resolution->is_active ||
+	       saved->is_default != resolution->is_default;
+}
+
+static enum ratbag_error_code
+transaction_validate_resolutions(struct ratbag_transaction_profile *saved,
+				 struct ratbag_profile *profile)
+{
+	struct ratbag_resolution *resolution;
+	unsigned int i = 0, nactive = 0, nactive_saved = 0, ndefault = 0;
+	bool changed = false;
+
+	ratbag_profile_for_each_resolution(profile, resolution) {
+		struct ratbag_transaction_resolution *r = &saved->resolutions[i++];
+
+		nactive += resolution->is_active;
+		nactive_saved += r->is_active;
+		ndefault += resolution->is_default;
+
+		if (!transaction_resolution_changed(r, resolution))
+			continue;
+
+		changed = true;
+
+		if (r->dpi_x == resolution->dpi_x &&
+		    r->dpi_y == resolution->dpi_y)
+			continue;
+
+		if (!ratbag_resolution_has_dpi(resolution, resolution->dpi_x) ||
+		    !ratbag_resolution_has_dpi(resolution, resolution->dpi_y))
+			return RATBAG_ERROR_VALUE;
+
+		if (resolution->dpi_x != resolution->dpi_y &&
+		    !ratbag_resolution_has_capability(resolution,
+						      RATBAG_RESOLUTION_CAP_SEPARATE_XY_RESOLUTION))
+			return RATBAG_ERROR_CAPABILITY;
+	}
+
+	if (!changed)
+		return RATBAG_SUCCESS;
+
+	/* Drivers don't always know the active resolution of a profile
+	 * that isn't in use, only insist on one where there was one */
+	if (nactive > 1 || ndefault > 1)
+		return RATBAG_ERROR_VALUE;
+	if (nactive == 0 && (profile->is_active || nactive_saved > 0))
+		return RATBAG_ERROR_VALUE;
+
+	return RATBAG_SUCCESS;
+}
+
+static enum ratbag_error_code
+transaction_validate_profile(struct ratbag_transaction_profile *saved,
+			     struct ratbag_profile *profile)
+{
+	struct ratbag_button *button;
+	struct ratbag_led *led;
+	unsigned int i;
+	enum ratbag_error_code rc;
+
+	if (saved->is_enabled != profile->is_enabled) {
+		if (!ratbag_profile_has_capability(profile,
+						   RATBAG_PROFILE_CAP_DISABLE))
+			return RATBAG_ERROR_CAPABILITY;
+		if (profile->is_active && !profile->is_enabled)
+			return RATBAG_ERROR_VALUE;
+	}
+
+	if (saved->hz != profile->hz && profile->nrates > 0) {
+		bool found = false;
+
+		for (i = 0; i < profile->nrates; i++) {
+			if (profile->rates[i] == profile->hz)
+				found = true;
+		}
+
+		if (!found)
+			return RATBAG_ERROR_VALUE;
+	}
+
+	rc = transaction_validate_resolutions(saved, profile);
+	if (rc != RATBAG_SUCCESS)
+		return rc;
+
+	i = 0;
+	ratbag_profile_for_each_button(profile, button) {
+		struct ratbag_transaction_button *b = &saved->buttons[i++];
+		enum ratbag_button_action_type type = button->action.type;
+
+		if (!transaction_button_changed(b, button) ||
+		    type == RATBAG_BUTTON_ACTION_TYPE_NONE)
+			continue;
+
+		if (!ratbag_button_has_action_type(button, type))
+			return RATBAG_ERROR_CAPABILITY;
+	}
+
+	i = 0;
+	ratbag_profile_for_each_led(profile, led) {
+		struct ratbag_transaction_led *l = &saved->leds[i++];
+
+		if (!transaction_led_changed(l, led))
+			continue;
+
+		if (led->brightness > 255 ||
+		    led->color.red > 255 ||
+		    led->color.green > 255 ||
+		    led->color.blue > 255)
+			return RATBAG_ERROR_VALUE;
+	}
+
+	return RATBAG_SUCCESS;
+}
+
+/* Objects that are back to their state from before the transaction are
+ * dropped from the change set unless they were already dirty then */
+static void
+transaction_merge_profile(struct ratbag_transaction_profile *saved,
+			  struct ratbag_profile *profile)
+{
+	struct ratbag_resolution *resolution;
+	struct ratbag_button *button;
+	struct ratbag_led *led;
+	unsigned int i;
+	bool changed = false;
+
+	i = 0;
+	ratbag_profile_for_each_resolution(profile, resolution) {
+		struct ratbag_transaction_resolution *r = &saved->resolutions[i++];
+
+		if (transaction_resolution_changed(r, resolution))
+			changed = true;
+		else
+			resolution->dirty = r->dirty;
+	}
+
+	i = 0;
+	ratbag_profile_for_each_button(profile, button) {
+		struct ratbag_transaction_button *b = &saved->buttons[i++];
+
+		if (transaction_button_changed(b, button))
+			changed = true;
+		else
+			button->dirty = b->dirty;
+	}
+
+	i = 0;
+	ratbag_profile_for_each_led(profile, led) {
+		struct ratbag_transaction_led *l = &saved->leds[i++];
+
+		if (transaction_led_changed(l, led))
+			changed = true;
+		else
+			led->dirty = l->dirty;
+	}
+
+	if (saved->hz == profile->hz)
+		profile->rate_dirty = saved->rate_dirty;
+	else
+		changed = true;
+
+	if (saved->is_enabled != profile->is_enabled ||
+	    !streq_ptr(saved->name, profile->name))
+		changed = true;
+
+	if (!changed)
+		profile->dirty = saved->dirty;
+}
+
+static void
+transaction_restore_profile(struct ratbag_transaction_profile *saved,
+			    struct ratbag_profile *profile)
+{
+	struct ratbag_resolution *resolution;
+	struct ratbag_button *button;
+	struct ratbag_led *led;
+	unsigned int i;
+
+	free(profile->name);
+	profile->name = strdup_safe(saved->name);
+	profile->hz = saved->hz;
+	profile->is_enabled = saved->is_enabled;
+	profile->dirty = saved->dirty;
+	profile->rate_dirty = saved->rate_dirty;
+
+	i = 0;
+	ratbag_profile_for_each_resolution(profile, resolution) {
+		struct ratbag_transaction_resolution *r = &saved->resolutions[i++];
+
+		resolution->dpi_x = r->dpi_x;
+		resolution->dpi_y = r->dpi_y;
+		resolution->is_active = r->is_active;
+		resolution->is_default = r->is_default;
+		resolution->dirty = r->dirty;
+	}
+
+	i = 0;
+	ratbag_profile_for_each_button(profile, button) {
+		struct ratbag_transaction_button *b = &saved->buttons[i++];
+		struct ratbag_button_action action = b->action;
+
+		if (b->macro) {
+			ratbag_button_copy_macro(button, b->macro);
+			action.macro = button->action.macro;
+		} else if (b->macro_pending) {
+			action.macro = button->action.macro;
+		}
+		ratbag_button_set_action(button, &action);
+		button->macro_pending = b->macro_pending;
+		button->dirty = b->dirty;
+	}
+
+	i = 0;
+	ratbag_profile_for_each_led(profile, led) {
+		struct ratbag_transaction_led *l = &saved->leds[i++];
+
+		led->mode = l->mode;
+		led->color = l->color;
+		led->ms = l->ms;
+		led->brightness = l->brightness;
+		led->dirty = l->dirty;
+	}
+}
+
+LIBRATBAG_EXPORT void
+ratbag_transaction_rollback(struct ratbag_transaction *transaction)
+{
+	struct ratbag_device *device = transaction->device;
+	struct ratbag_profile *profile;
+	unsigned int i = 0;
+
+	ratbag_device_for_each_profile(device, profile)
+		transaction_restore_profile(&transaction->profiles[i++],
+					    profile);
+
+	transaction_free(transaction);
+}
+
+LIBRATBAG_EXPORT enum ratbag_error_code
+ratbag_transaction_commit(struct ratbag_transaction *transaction)
+{
+	struct ratbag_device *device = transaction->device;
+	struct ratbag_profile *profile;
+	enum ratbag_error_code rc;
+	unsigned int i;
+
+	i = 0;
+	ratbag_device_for_each_profile(device, profile) {
+		rc = transaction_validate_profile(&transaction->profiles[i++],
+						  profile);
+		if (rc != RATBAG_SUCCESS) {
+			log_debug(device->ratbag,
+				  "%s: transaction on profile %d rejected: %d\n",
+				  device->name, profile->index, rc);
+			ratbag_transaction_rollback(transaction);
+			return rc;
+		}
+	}
+
+	i = 0;
+	ratbag_device_for_each_profile(device, profile)
+		transaction_merge_profile(&transaction->profiles[i++], profile);
+
+	rc = ratbag_device_write_changes(device);
+	transaction_free(transaction);
+
+	return rc;
+}
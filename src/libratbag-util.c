@@ -191,6 +191,65 @@ err:
 	return ret;
 }
 
+static inline uint64_t
+ratbag_poll_now_ms(void)
+{
+	return now(CLOCK_MONOTONIC) / 1000000;
+}
+
+int
+ratbag_poll_ready(struct ratbag_poll_latency *latency,
+		  unsigned int min_delay_ms,
+		  unsigned int timeout_ms,
+		  int (*is_ready)(void *data),
+		  void *data)
+{
+	uint64_t start, elapsed;
+	unsigned int delay = 1;
+	int rc;
+
+	start = ratbag_poll_now_ms();
+
+	if (min_delay_ms)
+		msleep(min_delay_ms);
+
+	rc = is_ready(data);
+
+	/* the first retry waits for the rest of the usual latency, from
+	 * there we back off */
+	elapsed = ratbag_poll_now_ms() - start;
+	if (latency && latency->ms > elapsed)
+		delay = latency->ms - elapsed;
+
+	while (rc == -EAGAIN) {
+		elapsed = ratbag_poll_now_ms() - start;
+		if (elapsed >= timeout_ms)
+			return -ETIMEDOUT;
+
+		if (delay > timeout_ms - elapsed)
+			delay = timeout_ms - elapsed;
+		msleep(delay);
+
+		delay *= 2;
+		if (delay > RATBAG_POLL_MAX_DELAY_MS)
+			delay = RATBAG_POLL_MAX_DELAY_MS;
+
+		rc = is_ready(data);
+	}
+
+	if (latency && rc >= 0) {
+		elapsed = ratbag_poll_now_ms() - start;
+		/* a running average, one slow command shouldn't make every
+		 * later wait slow too */
+		if (latency->ms)
+			latency->ms = (3 * latency->ms + elapsed) / 4;
+		else
+			latency->ms = elapsed;
+	}
+
+	return rc;
+}
+
 int mkdir_p(char *dir, mode_t mode)
 {
     struct stat sb;
@@ -214,6 +214,42 @@ ssize_t
 ratbag_utf8_from_enc(char *in_buf, size_t in_len, const char *from_enc,
 		     char **out);
 
+/* the longest sleep between two polls of ratbag_poll_ready() */
+#define RATBAG_POLL_MAX_DELAY_MS 100
+
+/**
+ * The time a device usually needs until it is ready again after a
+ * command, learned by ratbag_poll_ready(). Drivers keep one in their
+ * data, zero-initialized.
+ */
+struct ratbag_poll_latency {
+	unsigned int ms;
+};
+
+/**
+ * Waits for a device to be ready by calling is_ready until it returns
+ * something other than -EAGAIN.
+ *
+ * The first poll happens after min_delay_ms, the next one once the
+ * device's usual latency has passed, then the delay doubles up to
+ * RATBAG_POLL_MAX_DELAY_MS.
+ *
+ * @param latency the latency of the device, updated after a successful
+ * wait, may be NULL
+ * @param min_delay_ms time to wait before the first poll
+ * @param timeout_ms time after which to give up
+ * @param is_ready returns -EAGAIN while the device is busy
+ * @param data passed to is_ready
+ *
+ * @return the last value returned by is_ready or -ETIMEDOUT
+ */
+int
+ratbag_poll_ready(struct ratbag_poll_latency *latency,
+		  unsigned int min_delay_ms,
+		  unsigned int timeout_ms,
+		  int (*is_ready)(void *data),
+		  void *data);
+
 __attribute__((format(printf, 2, 3)))
 static inline int
 xasprintf(char **strp, const char *fmt, ...)
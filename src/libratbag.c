@@ -197,6 +197,9 @@ ratbag_device_new(struct ratbag *ratbag, struct udev_device *udev_device,
 	device->ids = *id;
 	device->data = ratbag_device_data_new_for_id(ratbag, id);
 	list_init(&device->profiles);
+	list_init(&device->macro_pool);
+	list_init(&device->dpi_lists);
+	list_init(&device->hidraw_endpoints);
 
 	list_insert(&ratbag->devices, &device->link);
 
@@ -207,6 +210,7 @@ void
 ratbag_device_destroy(struct ratbag_device *device)
 {
 	struct ratbag_profile *profile, *next;
+	struct ratbag_macro_events *events, *tmp;
 
 	if (!device)
 		return;
@@ -220,6 +224,14 @@ ratbag_device_destroy(struct ratbag_device *device)
 	list_for_each_safe(profile, next, &device->profiles, link)
 		ratbag_profile_destroy(profile);
 
+	/* whatever is left is used by macros the caller still holds */
+	list_for_each_safe(events, tmp, &device->macro_pool, link) {
+		list_remove(&events->link);
+		list_init(&events->link);
+	}
+
+	ratbag_hidraw_release_endpoints(device, true);
+
 	if (device->udev_device)
 		udev_device_unref(device->udev_device);
 
@@ -418,6 +430,8 @@ ratbag_assign_driver(struct ratbag_device *device,
 		rc = ratbag_driver_fallback_logitech(device, dev_id);
 	}
 
+	ratbag_hidraw_release_endpoints(device, false);
+
 	return rc;
 }
 
@@ -622,6 +636,8 @@ ratbag_unref(struct ratbag *ratbag)
 	assert(ratbag->refcount > 0);
 	ratbag->refcount--;
 	if (ratbag->refcount == 0) {
+		ratbag_data_cache_free(ratbag->data_cache);
+		ratbag_data_index_free(ratbag->data_index);
 		ratbag->udev = udev_unref(ratbag->udev);
 		free(ratbag);
 	}
@@ -927,8 +943,8 @@ ratbag_old_write_profile(struct ratbag_device *device)
 	return RATBAG_SUCCESS;
 }
 
-LIBRATBAG_EXPORT enum ratbag_error_code
-ratbag_device_commit(struct ratbag_device *device)
+enum ratbag_error_code
+ratbag_device_write_changes(struct ratbag_device *device)
 {
 	struct ratbag_profile *profile;
 	struct ratbag_button *button;
@@ -965,6 +981,19 @@ ratbag_device_commit(struct ratbag_device *device)
 	return RATBAG_SUCCESS;
 }
 
+LIBRATBAG_EXPORT enum ratbag_error_code
+ratbag_device_commit(struct ratbag_device *device)
+{
+	if (device->transaction) {
+		log_bug_client(device->ratbag,
+			       "%s: commit with an open transaction\n",
+			       device->name);
+		return RATBAG_ERROR_VALUE;
+	}
+
+	return ratbag_device_write_changes(device);
+}
+
 LIBRATBAG_EXPORT enum ratbag_error_code
 ratbag_profile_set_active(struct ratbag_profile *profile)
 {
@@ -1055,16 +1084,179 @@ ratbag_resolution_has_capability(struct ratbag_resolution *resolution,
 	return !!(resolution->capabilities & (1 << cap));
 }
 
-static inline bool
-resolution_has_dpi(struct ratbag_resolution *resolution,
-		   unsigned int dpi)
+static struct ratbag_dpi_list *
+ratbag_dpi_list_new(unsigned int nbands)
 {
-	for (size_t i = 0; i < resolution->ndpis; i++) {
-		if (dpi == resolution->dpis[i])
-			return true;
+	struct ratbag_dpi_list *list;
+
+	list = zalloc(sizeof(*list) + nbands * sizeof(struct ratbag_dpi_band));
+	list->refcount = 1;
+	list_init(&list->link);
+
+	return list;
+}
+
+static void
+ratbag_dpi_list_unref(struct ratbag_dpi_list *list)
+{
+	if (!list)
+		return;
+
+	assert(list->refcount > 0);
+	list->refcount--;
+	if (list->refcount > 0)
+		return;
+
+	list_remove(&list->link);
+	free(list);
+}
+
+/* Appends dpi to the list, extending the last band if dpi continues it.
+ * The list must have room for one more band. */
+static void
+ratbag_dpi_list_append(struct ratbag_dpi_list *list, unsigned int dpi)
+{
+	struct ratbag_dpi_band *band = NULL;
+
+	if (list->nbands > 0)
+		band = &list->bands[list->nbands - 1];
+
+	if (band && band->step == 0 && dpi > band->max) {
+		band->step = dpi - band->min;
+		band->max = dpi;
+	} else if (band && dpi == band->max + band->step) {
+		band->max = dpi;
+	} else {
+		band = &list->bands[list->nbands++];
+		band->min = dpi;
+		band->max = dpi;
+		band->step = 0;
+		band->index = list->ndpis;
 	}
 
-	return false;
+	list->ndpis++;
+}
+
+/* Replaces the resolution's DPI list with a reference to an identical
+ * list of the device, or a compact copy of the given one. */
+static void
+ratbag_resolution_intern_dpi_list(struct ratbag_resolution *res,
+				  const struct ratbag_dpi_list *dpis)
+{
+	struct ratbag_device *device = res->profile->device;
+	struct ratbag_dpi_list *list;
+
+	ratbag_dpi_list_unref(res->dpis);
+	res->dpis = NULL;
+
+	if (dpis->ndpis == 0)
+		return;
+
+	list_for_each(list, &device->dpi_lists, link) {
+		if (list->nbands == dpis->nbands &&
+		    memcmp(list->bands, dpis->bands,
+			   dpis->nbands * sizeof(struct ratbag_dpi_band)) == 0) {
+			assert(list->refcount < INT_MAX);
+			list->refcount++;
+			res->dpis = list;
+			return;
+		}
+	}
+
+	list = ratbag_dpi_list_new(dpis->nbands);
+	list->ndpis = dpis->ndpis;
+	list->nbands = dpis->nbands;
+	memcpy(list->bands, dpis->bands,
+	       dpis->nbands * sizeof(struct ratbag_dpi_band));
+	list_insert(&device->dpi_lists, &list->link);
+	res->dpis = list;
+}
+
+static inline unsigned int
+ratbag_dpi_range_next_step(unsigned int dpi)
+{
+	if (dpi < 1000)
+		return 50;
+	else if (dpi < 2600)
+		return 100;
+	else if (dpi < 5000)
+		return 200;
+	else
+		return 500;
+}
+
+void
+ratbag_resolution_set_dpi_list_from_range(struct ratbag_resolution *res,
+					  unsigned int min, unsigned int max)
+{
+	struct ratbag_dpi_list *list;
+	unsigned int dpi;
+
+	/* every change of the step size starts a new band, that's at most
+	 * one per step size */
+	list = ratbag_dpi_list_new(4);
+	for (dpi = min; dpi <= max; dpi += ratbag_dpi_range_next_step(dpi))
+		ratbag_dpi_list_append(list, dpi);
+
+	ratbag_resolution_intern_dpi_list(res, list);
+	ratbag_dpi_list_unref(list);
+}
+
+void
+ratbag_resolution_set_dpi_list(struct ratbag_resolution *res,
+			       unsigned int *dpis,
+			       size_t ndpis)
+{
+	struct ratbag_dpi_list *list;
+
+	list = ratbag_dpi_list_new(ndpis);
+	for (size_t i = 0; i < ndpis; i++) {
+		if (i > 0)
+			assert(dpis[i] > dpis[i - 1]);
+		ratbag_dpi_list_append(list, dpis[i]);
+	}
+
+	ratbag_resolution_intern_dpi_list(res, list);
+	ratbag_dpi_list_unref(list);
+}
+
+int
+ratbag_resolution_get_dpi_index(const struct ratbag_resolution *res,
+				unsigned int dpi)
+{
+	const struct ratbag_dpi_list *list = res->dpis;
+	unsigned int lo = 0, hi;
+
+	if (!list)
+		return -1;
+
+	/* the bands are sorted and don't overlap */
+	hi = list->nbands;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		const struct ratbag_dpi_band *band = &list->bands[mid];
+
+		if (dpi < band->min) {
+			hi = mid;
+		} else if (dpi > band->max) {
+			lo = mid + 1;
+		} else {
+			if (band->step == 0)
+				return band->index;
+			if ((dpi - band->min) % band->step)
+				return -1;
+			return band->index + (dpi - band->min) / band->step;
+		}
+	}
+
+	return -1;
+}
+
+bool
+ratbag_resolution_has_dpi(const struct ratbag_resolution *res,
+			  unsigned int dpi)
+{
+	return ratbag_resolution_get_dpi_index(res, dpi) >= 0;
 }
 
 LIBRATBAG_EXPORT enum ratbag_error_code
@@ -1073,7 +1265,7 @@ ratbag_resolution_set_dpi(struct ratbag_resolution *resolution,
 {
 	struct ratbag_profile *profile = resolution->profile;
 
-	if (!resolution_has_dpi(resolution, dpi))
+	if (!ratbag_resolution_has_dpi(resolution, dpi))
 		return RATBAG_ERROR_VALUE;
 
 	if (resolution->dpi_x != dpi || resolution->dpi_y != dpi) {
@@ -1099,7 +1291,7 @@ ratbag_resolution_set_dpi_xy(struct ratbag_resolution *resolution,
 	if ((x == 0 && y != 0) || (x != 0 && y == 0))
 		return RATBAG_ERROR_VALUE;
 
-	if (!resolution_has_dpi(resolution, x) || !resolution_has_dpi(resolution, y))
+	if (!ratbag_resolution_has_dpi(resolution, x) || !ratbag_resolution_has_dpi(resolution, y))
 		return RATBAG_ERROR_VALUE;
 
 	if (resolution->dpi_x != x || resolution->dpi_y != y) {
@@ -1136,17 +1328,25 @@ ratbag_resolution_get_dpi_list(struct ratbag_resolution *resolution,
 			       unsigned int *resolutions,
 			       size_t nres)
 {
-	_Static_assert(sizeof(*resolutions) == sizeof(*resolution->dpis), "type mismatch");
+	const struct ratbag_dpi_list *list = resolution->dpis;
+	size_t n = 0;
 
 	assert(nres > 0);
 
-	if (resolution->ndpis == 0)
+	if (!list)
 		return 0;
 
-	memcpy(resolutions, resolution->dpis,
-	       sizeof(unsigned int) * min(nres, resolution->ndpis));
+	for (unsigned int i = 0; i < list->nbands && n < nres; i++) {
+		const struct ratbag_dpi_band *band = &list->bands[i];
+		unsigned int dpi = band->min;
+
+		do {
+			resolutions[n++] = dpi;
+			dpi += band->step;
+		} while (band->step && dpi <= band->max && n < nres);
+	}
 
-	return resolution->ndpis;
+	return list->ndpis;
 }
 
 LIBRATBAG_EXPORT int
@@ -1438,6 +1638,7 @@ ratbag_button_destroy(struct ratbag_button *button)
 	if (button->action.macro) {
 		free(button->action.macro->name);
 		free(button->action.macro->group);
+		ratbag_macro_events_unref(button->action.macro->events);
 		free(button->action.macro);
 	}
 	free(button);
@@ -1454,6 +1655,7 @@ static void
 ratbag_resolution_destroy(struct ratbag_resolution *res)
 {
 	list_remove(&res->link);
+	ratbag_dpi_list_unref(res->dpis);
 	free(res);
 }
 
@@ -1495,11 +1697,12 @@ LIBRATBAG_EXPORT bool
 ratbag_led_has_mode(struct ratbag_led *led,
 		    enum ratbag_led_mode mode)
 {
-	assert(mode <= RATBAG_LED_BREATHING);
-
 	if (mode == RATBAG_LED_OFF)
 		return 1;
 
+	if ((unsigned int)mode >= sizeof(led->modes) * 8)
+		return 0;
+
 	return !!(led->modes & (1 << mode));
 }
 
@@ -1524,6 +1727,9 @@ ratbag_led_get_brightness(struct ratbag_led *led)
 LIBRATBAG_EXPORT enum ratbag_error_code
 ratbag_led_set_mode(struct ratbag_led *led, enum ratbag_led_mode mode)
 {
+	if (!ratbag_led_has_mode(led, mode))
+		return RATBAG_ERROR_CAPABILITY;
+
 	led->mode = mode;
 	led->dirty = true;
 	led->profile->dirty = true;
@@ -1671,6 +1877,166 @@ ratbag_resolution_get_user_data(const struct ratbag_resolution *ratbag_resolutio
 	return ratbag_resolution->userdata;
 }
 
+static struct ratbag_macro_events *
+ratbag_macro_events_new(unsigned int capacity)
+{
+	struct ratbag_macro_events *events;
+
+	events = zalloc(sizeof(*events) +
+			capacity * sizeof(struct ratbag_macro_event));
+	events->refcount = 1;
+	events->capacity = capacity;
+	list_init(&events->link);
+
+	return events;
+}
+
+static struct ratbag_macro_events *
+ratbag_macro_events_ref(struct ratbag_macro_events *events)
+{
+	if (!events)
+		return NULL;
+
+	assert(events->refcount < INT_MAX);
+	events->refcount++;
+
+	return events;
+}
+
+void
+ratbag_macro_events_unref(struct ratbag_macro_events *events)
+{
+	if (!events)
+		return;
+
+	assert(events->refcount > 0);
+	events->refcount--;
+	if (events->refcount > 0)
+		return;
+
+	list_remove(&events->link);
+	free(events);
+}
+
+void
+ratbag_macro_set_event(struct ratbag_macro *macro,
+		       unsigned int index,
+		       const struct ratbag_macro_event *event)
+{
+	struct ratbag_macro_events *events = macro->events;
+	unsigned int count = ratbag_macro_get_num_events(macro);
+
+	assert(index < MAX_MACRO_EVENTS);
+
+	/* everything past the end is RATBAG_MACRO_EVENT_NONE already */
+	if (index >= count && event->type == RATBAG_MACRO_EVENT_NONE)
+		return;
+
+	count = max(count, index + 1);
+
+	/* the events may be shared with other macros, copy them first */
+	if (!events || events->refcount > 1 || count > events->capacity) {
+		unsigned int capacity = events ? events->capacity : 4;
+
+		while (capacity < count)
+			capacity *= 2;
+		capacity = min(capacity, (unsigned int)MAX_MACRO_EVENTS);
+
+		macro->events = ratbag_macro_events_new(capacity);
+		if (events) {
+			macro->events->count = events->count;
+			memcpy(macro->events->events, events->events,
+			       events->count * sizeof(struct ratbag_macro_event));
+			ratbag_macro_events_unref(events);
+		}
+		events = macro->events;
+	}
+
+	events->events[index] = *event;
+	events->count = count;
+}
+
+bool
+ratbag_macro_has_same_events(const struct ratbag_macro *a,
+			     const struct ratbag_macro *b)
+{
+	unsigned int count = ratbag_macro_get_num_events(a);
+
+	if (a->events == b->events)
+		return true;
+
+	if (count != ratbag_macro_get_num_events(b))
+		return false;
+
+	return count == 0 ||
+	       memcmp(a->events->events, b->events->events,
+		      count * sizeof(struct ratbag_macro_event)) == 0;
+}
+
+/**
+ * Returns a reference to the events in the device's macro pool that match
+ * the given ones, adding a compact copy of them to the pool if there are
+ * none yet. Buttons with the same macro thus share its events.
+ */
+static struct ratbag_macro_events *
+ratbag_device_intern_macro_events(struct ratbag_device *device,
+				  const struct ratbag_macro *macro)
+{
+	struct ratbag_macro_events *events;
+	unsigned int count = ratbag_macro_get_num_events(macro);
+
+	if (count == 0)
+		return NULL;
+
+	list_for_each(events, &device->macro_pool, link) {
+		if (events->count == count &&
+		    memcmp(events->events, macro->events->events,
+			   count * sizeof(struct ratbag_macro_event)) == 0)
+			return ratbag_macro_events_ref(events);
+	}
+
+	events = ratbag_macro_events_new(count);
+	events->count = count;
+	memcpy(events->events, macro->events->events,
+	       count * sizeof(struct ratbag_macro_event));
+	list_insert(&device->macro_pool, &events->link);
+
+	return events;
+}
+
+static void
+ratbag_button_read_pending_macro(struct ratbag_button *button)
+{
+	struct ratbag_device *device = button->profile->device;
+	int rc;
+
+	if (!button->macro_pending)
+		return;
+
+	/* only try once, a failure is not going to fix itself */
+	button->macro_pending = false;
+
+	if (button->action.type != RATBAG_BUTTON_ACTION_TYPE_MACRO ||
+	    !device->driver->read_button_macro)
+		return;
+
+	rc = device->driver->read_button_macro(button);
+	if (rc)
+		log_error(device->ratbag,
+			  "%s: unable to read the macro of button %d of profile %d: %s (%d)\n",
+			  device->name, button->index, button->profile->index,
+			  strerror(-rc), rc);
+
+	/* a macro button always has a macro, fall back to an empty one */
+	if (!button->action.macro) {
+		struct ratbag_button_macro *empty;
+
+		empty = ratbag_button_macro_new("");
+		ratbag_button_copy_macro(button, empty);
+		ratbag_button_macro_unref(empty);
+	}
+}
+
 LIBRATBAG_EXPORT struct ratbag_button_macro *
 ratbag_button_get_macro(struct ratbag_button *button)
 {
@@ -1679,10 +2045,12 @@ ratbag_button_get_macro(struct ratbag_button *button)
 	if (button->action.type != RATBAG_BUTTON_ACTION_TYPE_MACRO)
 		return NULL;
 
+	ratbag_button_read_pending_macro(button);
+	if (!button->action.macro)
+		return NULL;
+
 	macro = ratbag_button_macro_new(button->action.macro->name);
-	memcpy(macro->macro.events,
-	       button->action.macro->events,
-	       sizeof(macro->macro.events));
+	macro->macro.events = ratbag_macro_events_ref(button->action.macro->events);
 
 	return macro;
 }
@@ -1691,18 +2059,21 @@ void
 ratbag_button_copy_macro(struct ratbag_button *button,
 			 const struct ratbag_button_macro *macro)
 {
+	struct ratbag_device *device = button->profile->device;
+
 	if (!button->action.macro)
 		button->action.macro = zalloc(sizeof(struct ratbag_macro));
 	else {
 		free(button->action.macro->name);
 		free(button->action.macro->group);
+		ratbag_macro_events_unref(button->action.macro->events);
 		memset(button->action.macro, 0, sizeof(struct ratbag_macro));
 	}
 
 	button->action.type = RATBAG_BUTTON_ACTION_TYPE_MACRO;
-	memcpy(button->action.macro->events,
-	       macro->macro.events,
-	       sizeof(macro->macro.events));
+	button->macro_pending = false;
+	button->action.macro->events =
+		ratbag_device_intern_macro_events(device, &macro->macro);
 	button->action.macro->name = strdup_safe(macro->macro.name);
 	button->action.macro->group = strdup_safe(macro->macro.group);
 }
@@ -1728,7 +2099,7 @@ ratbag_button_macro_set_event(struct ratbag_button_macro *m,
 			      enum ratbag_macro_event_type type,
 			      unsigned int data)
 {
-	struct ratbag_macro *macro = &m->macro;
+	struct ratbag_macro_event event = { .type = type };
 
 	if (index >= MAX_MACRO_EVENTS)
 		return RATBAG_ERROR_VALUE;
@@ -1736,20 +2107,19 @@ ratbag_button_macro_set_event(struct ratbag_button_macro *m,
 	switch (type) {
 	case RATBAG_MACRO_EVENT_KEY_PRESSED:
 	case RATBAG_MACRO_EVENT_KEY_RELEASED:
-		macro->events[index].type = type;
-		macro->events[index].event.key = data;
+		event.event.key = data;
 		break;
 	case RATBAG_MACRO_EVENT_WAIT:
-		macro->events[index].type = type;
-		macro->events[index].event.timeout = data;
+		event.event.timeout = data;
 		break;
 	case RATBAG_MACRO_EVENT_NONE:
-		macro->events[index].type = type;
 		break;
 	default:
 		return RATBAG_ERROR_VALUE;
 	}
 
+	ratbag_macro_set_event(&m->macro, index, &event);
+
 	return 0;
 }
 
@@ -1759,37 +2129,39 @@ ratbag_button_macro_get_event_type(struct ratbag_button_macro *macro, unsigned i
 	if (index >= MAX_MACRO_EVENTS)
 		return RATBAG_MACRO_EVENT_INVALID;
 
-	return macro->macro.events[index].type;
+	return ratbag_macro_get_event(&macro->macro, index).type;
 }
 
 LIBRATBAG_EXPORT int
 ratbag_button_macro_get_event_key(struct ratbag_button_macro *m, unsigned int index)
 {
-	struct ratbag_macro *macro = &m->macro;
+	struct ratbag_macro_event event;
 
 	if (index >= MAX_MACRO_EVENTS)
 		return 0;
 
-	if (macro->events[index].type != RATBAG_MACRO_EVENT_KEY_PRESSED &&
-	    macro->events[index].type != RATBAG_MACRO_EVENT_KEY_RELEASED)
+	event = ratbag_macro_get_event(&m->macro, index);
+	if (event.type != RATBAG_MACRO_EVENT_KEY_PRESSED &&
+	    event.type != RATBAG_MACRO_EVENT_KEY_RELEASED)
 		return -EINVAL;
 
-	return macro->events[index].event.key;
+	return event.event.key;
 }
 
 LIBRATBAG_EXPORT int
 ratbag_button_macro_get_event_timeout(struct ratbag_button_macro *m,
 				      unsigned int index)
 {
-	struct ratbag_macro *macro = &m->macro;
+	struct ratbag_macro_event event;
 
 	if (index >= MAX_MACRO_EVENTS)
 		return 0;
 
-	if (macro->events[index].type != RATBAG_MACRO_EVENT_WAIT)
+	event = ratbag_macro_get_event(&m->macro, index);
+	if (event.type != RATBAG_MACRO_EVENT_WAIT)
 		return 0;
 
-	return macro->events[index].event.timeout;
+	return event.event.timeout;
 }
 
 LIBRATBAG_EXPORT unsigned int
@@ -1810,6 +2182,7 @@ ratbag_button_macro_destroy(struct ratbag_button_macro *macro)
 	assert(macro->refcount == 0);
 	free(macro->macro.name);
 	free(macro->macro.group);
+	ratbag_macro_events_unref(macro->macro.events);
 	free(macro);
 }
 
@@ -1914,10 +2287,10 @@ ratbag_action_macro_num_keys(struct ratbag_button_action *action)
 	int i, count;
 
 	count = 0;
-	for (i = 0; i < MAX_MACRO_EVENTS; i++) {
+	for (i = 0; i < ratbag_macro_get_num_events(macro); i++) {
 		struct ratbag_macro_event event;
 
-		event = macro->events[i];
+		event = ratbag_macro_get_event(macro, i);
 		if (event.type == RATBAG_MACRO_EVENT_KEY_PRESSED)
 		{
 			switch(event.event.key) {
@@ -1952,7 +2325,7 @@ ratbag_action_keycode_from_macro(struct ratbag_button_action *action,
 	if (!macro || action->type != RATBAG_BUTTON_ACTION_TYPE_MACRO)
 		return -EINVAL;
 
-	if (macro->events[0].type == RATBAG_MACRO_EVENT_NONE)
+	if (ratbag_macro_get_event(macro, 0).type == RATBAG_MACRO_EVENT_NONE)
 		return -EINVAL;
 
 	if (ratbag_action_macro_num_keys(action) != 1)
@@ -1961,7 +2334,7 @@ ratbag_action_keycode_from_macro(struct ratbag_button_action *action,
 	for (i = 0; i < MAX_MACRO_EVENTS; i++) {
 		struct ratbag_macro_event event;
 
-		event = macro->events[i];
+		event = ratbag_macro_get_event(macro, i);
 		switch (event.type) {
 		case RATBAG_MACRO_EVENT_INVALID:
 			return -EINVAL;
@@ -92,6 +92,17 @@ struct ratbag;
  */
 struct ratbag_device;
 
+/**
+ * @ingroup device
+ * @struct ratbag_transaction
+ *
+ * A set of changes to a device that is validated and written as a whole,
+ * see ratbag_device_begin_transaction(). This struct is not refcounted,
+ * it is freed by ratbag_transaction_commit() or
+ * ratbag_transaction_rollback().
+ */
+struct ratbag_transaction;
+
 /**
  * @ingroup profile
  * @struct ratbag_profile
@@ -483,6 +494,59 @@ ratbag_device_get_product_version(const struct ratbag_device *device);
 enum ratbag_error_code
 ratbag_device_commit(struct ratbag_device *device);
 
+/**
+ * @ingroup device
+ *
+ * Start a transaction on the device. All changes made through the
+ * regular setters from now on are staged until
+ * ratbag_transaction_commit() validates them together and writes them
+ * to the device in a single commit, or ratbag_transaction_rollback()
+ * reverts them. Only one transaction may be open on a device at any
+ * time and ratbag_device_commit() fails while it is open.
+ *
+ * Changes that are reverted within the transaction, e.g. a resolution
+ * that is changed and then set back to its original value, are not
+ * written to the device.
+ *
+ * ratbag_profile_set_active() takes effect immediately and is not part
+ * of a transaction.
+ *
+ * @param device A previously initialized ratbag device
+ * @return A new transaction or NULL if a transaction is already open on
+ * this device
+ */
+struct ratbag_transaction *
+ratbag_device_begin_transaction(struct ratbag_device *device);
+
+/**
+ * @ingroup device
+ *
+ * Validate all changes staged in the transaction against the device's
+ * capabilities and write them to the device. If any change is invalid,
+ * all changes made in the transaction are reverted and nothing is
+ * written to the device.
+ *
+ * The transaction is freed by this call, regardless of the result.
+ *
+ * @param transaction A transaction returned by
+ * ratbag_device_begin_transaction()
+ * @return 0 on success or an error code otherwise
+ */
+enum ratbag_error_code
+ratbag_transaction_commit(struct ratbag_transaction *transaction);
+
+/**
+ * @ingroup device
+ *
+ * Revert all changes staged in the transaction. The transaction is freed
+ * by this call.
+ *
+ * @param transaction A transaction returned by
+ * ratbag_device_begin_transaction()
+ */
+void
+ratbag_transaction_rollback(struct ratbag_transaction *transaction);
+
 /**
  * @ingroup device
  *
@@ -1275,7 +1339,9 @@ ratbag_led_get_brightness(struct ratbag_led *led);
  *
  * @param led A previously initialized ratbag LED
  * @param mode LED mode @ref ratbag_led_mode.
- * @return 0 on success or an error code otherwise.
+ * @return 0 on success or an error code otherwise. If the LED does not
+ * support the mode, RATBAG_ERROR_CAPABILITY is returned and the mode is
+ * left unchanged.
  *
  * @see ratbag_led_get_mode
  */
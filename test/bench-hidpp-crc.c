@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Throughput of the CRC-CCITT implementations over typical onboard profile
+ * sector sizes. Run with meson test --benchmark.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hidpp-crc.h"
+#include "libratbag-util.h"
+
+#define BENCH_BYTES (64 * 1024 * 1024)
+
+static const struct implementation {
+	const char *name;
+	uint16_t (*crc)(const uint8_t *data, unsigned int length);
+} implementations[] = {
+	{ "bytewise", hidpp_crc_ccitt_bytewise },
+	{ "table", hidpp_crc_ccitt_table },
+	{ "slice8", hidpp_crc_ccitt_slice8 },
+	{ "default", hidpp_crc_ccitt },
+};
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+	       (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(void)
+{
+	static const unsigned int sizes[] = { 16, 255, 1024, 4096 };
+	static uint8_t buf[4096];
+	const struct implementation *impl;
+	const unsigned int *size;
+	struct timespec start, end;
+	unsigned int i, rounds;
+	volatile uint16_t sink = 0;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = rand();
+
+	ARRAY_FOR_EACH(sizes, size) {
+		rounds = BENCH_BYTES / *size;
+
+		ARRAY_FOR_EACH(implementations, impl) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < rounds; i++)
+				sink ^= impl->crc(buf, *size);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			printf("%5u bytes %-8s %8.1f MB/s\n", *size, impl->name,
+			       BENCH_BYTES / elapsed(&start, &end) / 1e6);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
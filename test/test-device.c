@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
+#include <linux/input.h>
 #include <sys/resource.h>
 
 #include "libratbag.h"
@@ -435,6 +436,56 @@ START_TEST(device_resolutions)
 }
 END_TEST
 
+START_TEST(device_resolutions_dpi_list)
+{
+	struct ratbag *r;
+	struct ratbag_device *d;
+	struct ratbag_profile *p;
+	struct ratbag_resolution *res;
+	unsigned int dpis[200];
+	unsigned int dpi = 100;
+	size_t ndpis;
+	size_t i;
+
+	struct ratbag_test_device td = sane_device;
+
+	r = ratbag_create_context(&abort_iface, NULL);
+	d = ratbag_device_new_test_device(r, &td);
+	p = ratbag_device_get_profile(d, 0);
+	res = ratbag_profile_get_resolution(p, 0);
+
+	ndpis = ratbag_resolution_get_dpi_list(res, dpis, ARRAY_LENGTH(dpis));
+	ck_assert_int_lt(ndpis, ARRAY_LENGTH(dpis));
+	for (i = 0; i < ndpis; i++) {
+		ck_assert_int_eq(dpis[i], dpi);
+		if (dpi < 1000)
+			dpi += 50;
+		else if (dpi < 2600)
+			dpi += 100;
+		else
+			dpi += 200;
+	}
+
+	/* a truncated list returns the full count */
+	ck_assert_int_eq(ratbag_resolution_get_dpi_list(res, dpis, 3), ndpis);
+	ck_assert_int_eq(dpis[2], 200);
+
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 950), RATBAG_SUCCESS);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 1000), RATBAG_SUCCESS);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 1050), RATBAG_ERROR_VALUE);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 2800), RATBAG_SUCCESS);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 2900), RATBAG_ERROR_VALUE);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 5000), RATBAG_SUCCESS);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 5200), RATBAG_ERROR_VALUE);
+	ck_assert_int_eq(ratbag_resolution_set_dpi(res, 25), RATBAG_ERROR_VALUE);
+
+	ratbag_resolution_unref(res);
+	ratbag_profile_unref(p);
+	ratbag_device_unref(d);
+	ratbag_unref(r);
+}
+END_TEST
+
 START_TEST(device_resolutions_ref_unref)
 {
 	struct ratbag *r;
@@ -795,6 +846,68 @@ START_TEST(device_buttons_set)
 }
 END_TEST
 
+START_TEST(device_buttons_macro)
+{
+	struct ratbag *r;
+	struct ratbag_device *d;
+	struct ratbag_profile *p0, *p1;
+	struct ratbag_button *b0, *b1;
+	struct ratbag_button_macro *m0, *m1;
+	int i;
+
+	struct ratbag_test_device td = sane_device;
+	td.num_buttons = 10;
+
+	for (i = 0; i < 2; i++) {
+		td.profiles[i].buttons[2].action_type = RATBAG_BUTTON_ACTION_TYPE_MACRO;
+		td.profiles[i].buttons[2].macro[0].type = RATBAG_MACRO_EVENT_KEY_PRESSED;
+		td.profiles[i].buttons[2].macro[0].value = KEY_A;
+		td.profiles[i].buttons[2].macro[1].type = RATBAG_MACRO_EVENT_KEY_RELEASED;
+		td.profiles[i].buttons[2].macro[1].value = KEY_A;
+	}
+
+	r = ratbag_create_context(&abort_iface, NULL);
+	d = ratbag_device_new_test_device(r, &td);
+	p0 = ratbag_device_get_profile(d, 0);
+	p1 = ratbag_device_get_profile(d, 1);
+	b0 = ratbag_profile_get_button(p0, 2);
+	b1 = ratbag_profile_get_button(p1, 2);
+
+	/* modifying a macro leaves the buttons using the same macro alone */
+	m0 = ratbag_button_get_macro(b0);
+	ck_assert_int_eq(ratbag_button_macro_get_event_key(m0, 0), KEY_A);
+	ratbag_button_macro_set_event(m0, 2, RATBAG_MACRO_EVENT_WAIT, 50);
+	ratbag_button_macro_set_event(m0, 3, RATBAG_MACRO_EVENT_KEY_PRESSED, KEY_B);
+	ck_assert_int_eq(ratbag_button_set_macro(b0, m0), RATBAG_SUCCESS);
+
+	m1 = ratbag_button_get_macro(b1);
+	ck_assert_int_eq(ratbag_button_macro_get_event_key(m1, 0), KEY_A);
+	ck_assert_int_eq(ratbag_button_macro_get_event_type(m1, 2),
+			 RATBAG_MACRO_EVENT_NONE);
+	ratbag_button_macro_unref(m1);
+
+	m1 = ratbag_button_get_macro(b0);
+	ck_assert_int_eq(ratbag_button_macro_get_event_timeout(m1, 2), 50);
+	ck_assert_int_eq(ratbag_button_macro_get_event_key(m1, 3), KEY_B);
+	ck_assert_int_eq(ratbag_button_macro_get_event_type(m1, 4),
+			 RATBAG_MACRO_EVENT_NONE);
+
+	ratbag_button_unref(b0);
+	ratbag_button_unref(b1);
+	ratbag_profile_unref(p0);
+	ratbag_profile_unref(p1);
+	ratbag_device_unref(d);
+	ratbag_unref(r);
+
+	/* the macros outlive the device */
+	ck_assert_int_eq(ratbag_button_macro_get_event_key(m1, 3), KEY_B);
+	ratbag_button_macro_set_event(m1, 0, RATBAG_MACRO_EVENT_KEY_PRESSED, KEY_C);
+	ck_assert_int_eq(ratbag_button_macro_get_event_key(m0, 0), KEY_A);
+	ratbag_button_macro_unref(m0);
+	ratbag_button_macro_unref(m1);
+}
+END_TEST
+
 static void
 assert_led_equals(struct ratbag_led *l, struct ratbag_test_led e_l)
 {
@@ -882,6 +995,9 @@ START_TEST(device_leds_set)
 	l = ratbag_profile_get_led(p, 0);
 
 	ratbag_led_set_mode(l, RATBAG_LED_BREATHING);
+	ck_assert_int_eq(ratbag_led_set_mode(l, (enum ratbag_led_mode)40),
+			 RATBAG_ERROR_CAPABILITY);
+	ck_assert_int_eq(ratbag_led_get_mode(l), RATBAG_LED_BREATHING);
 	ratbag_led_set_color(l, c);
 	ratbag_led_set_effect_duration(l, 90);
 	ratbag_led_set_brightness(l, 22);
@@ -908,6 +1024,140 @@ START_TEST(device_leds_set)
 }
 END_TEST
 
+START_TEST(device_transaction_commit)
+{
+	struct ratbag *r;
+	struct ratbag_device *d;
+	struct ratbag_profile *p;
+	struct ratbag_resolution *res;
+	struct ratbag_led *l;
+	struct ratbag_transaction *t;
+	enum ratbag_error_code rc;
+
+	struct ratbag_test_device td = sane_device;
+
+	r = ratbag_create_context(&abort_iface, NULL);
+	d = ratbag_device_new_test_device(r, &td);
+	p = ratbag_device_get_profile(d, 0);
+	res = ratbag_profile_get_resolution(p, 0);
+	l = ratbag_profile_get_led(p, 0);
+
+	t = ratbag_device_begin_transaction(d);
+	ck_assert(t != NULL);
+
+	rc = ratbag_resolution_set_dpi(res, 800);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+	rc = ratbag_led_set_mode(l, RATBAG_LED_BREATHING);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+	rc = ratbag_profile_set_report_rate(p, 500);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+
+	rc = ratbag_transaction_commit(t);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+
+	ck_assert_int_eq(ratbag_resolution_get_dpi(res), 800);
+	ck_assert_int_eq(ratbag_led_get_mode(l), RATBAG_LED_BREATHING);
+	ck_assert_int_eq(ratbag_profile_get_report_rate(p), 500);
+
+	/* the transaction is closed, a new one can be opened */
+	t = ratbag_device_begin_transaction(d);
+	ck_assert(t != NULL);
+	ratbag_transaction_rollback(t);
+
+	ratbag_led_unref(l);
+	ratbag_resolution_unref(res);
+	ratbag_profile_unref(p);
+	ratbag_device_unref(d);
+	ratbag_unref(r);
+}
+END_TEST
+
+START_TEST(device_transaction_rollback)
+{
+	struct ratbag *r;
+	struct ratbag_device *d;
+	struct ratbag_profile *p;
+	struct ratbag_resolution *res;
+	struct ratbag_button *b;
+	struct ratbag_transaction *t;
+	enum ratbag_error_code rc;
+
+	struct ratbag_test_device td = sane_device;
+	td.profiles[0].buttons[0].action_type = RATBAG_BUTTON_ACTION_TYPE_BUTTON;
+	td.profiles[0].buttons[0].button = 1;
+
+	r = ratbag_create_context(&abort_iface, NULL);
+	d = ratbag_device_new_test_device(r, &td);
+	p = ratbag_device_get_profile(d, 0);
+	res = ratbag_profile_get_resolution(p, 0);
+	b = ratbag_profile_get_button(p, 0);
+
+	t = ratbag_device_begin_transaction(d);
+	ck_assert(t != NULL);
+
+	rc = ratbag_resolution_set_dpi(res, 800);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+	rc = ratbag_button_set_button(b, 5);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+
+	ratbag_transaction_rollback(t);
+
+	ck_assert_int_eq(ratbag_resolution_get_dpi_x(res), 100);
+	ck_assert_int_eq(ratbag_resolution_get_dpi_y(res), 200);
+	ck_assert_int_eq(ratbag_button_get_button(b), 1);
+
+	ratbag_button_unref(b);
+	ratbag_resolution_unref(res);
+	ratbag_profile_unref(p);
+	ratbag_device_unref(d);
+	ratbag_unref(r);
+}
+END_TEST
+
+START_TEST(device_transaction_invalid)
+{
+	struct ratbag *r;
+	struct ratbag_device *d;
+	struct ratbag_profile *p;
+	struct ratbag_resolution *res;
+	struct ratbag_transaction *t;
+	enum ratbag_error_code rc;
+
+	struct ratbag_test_device td = sane_device;
+
+	r = ratbag_create_context(&abort_iface, NULL);
+	d = ratbag_device_new_test_device(r, &td);
+	p = ratbag_device_get_profile(d, 0);
+	res = ratbag_profile_get_resolution(p, 1);
+
+	t = ratbag_device_begin_transaction(d);
+	ck_assert(t != NULL);
+
+	/* a second transaction or a plain commit are refused */
+	ck_assert(ratbag_device_begin_transaction(d) == NULL);
+	ck_assert_int_eq(ratbag_device_commit(d), RATBAG_ERROR_VALUE);
+
+	rc = ratbag_resolution_set_dpi(res, 1000);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+	/* not in the device's report rate list */
+	rc = ratbag_profile_set_report_rate(p, 123);
+	ck_assert_int_eq(rc, RATBAG_SUCCESS);
+
+	rc = ratbag_transaction_commit(t);
+	ck_assert_int_eq(rc, RATBAG_ERROR_VALUE);
+
+	/* all of the transaction was reverted */
+	ck_assert_int_eq(ratbag_profile_get_report_rate(p), 1000);
+	ck_assert_int_eq(ratbag_resolution_get_dpi_x(res), 200);
+	ck_assert_int_eq(ratbag_resolution_get_dpi_y(res), 300);
+
+	ratbag_resolution_unref(res);
+	ratbag_profile_unref(p);
+	ratbag_device_unref(d);
+	ratbag_unref(r);
+}
+END_TEST
+
 static Suite *
 test_context_suite(void)
 {
@@ -938,12 +1188,14 @@ test_context_suite(void)
 	tcase_add_test(tc, device_resolutions);
 	tcase_add_test(tc, device_resolutions_ref_unref);
 	tcase_add_test(tc, device_resolutions_num_0);
+	tcase_add_test(tc, device_resolutions_dpi_list);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("buttons");
 	tcase_add_test(tc, device_buttons);
 	tcase_add_test(tc, device_buttons_ref_unref);
 	tcase_add_test(tc, device_buttons_set);
+	tcase_add_test(tc, device_buttons_macro);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("led");
@@ -951,6 +1203,12 @@ test_context_suite(void)
 	tcase_add_test(tc, device_leds_set);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("transactions");
+	tcase_add_test(tc, device_transaction_commit);
+	tcase_add_test(tc, device_transaction_rollback);
+	tcase_add_test(tc, device_transaction_invalid);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
 
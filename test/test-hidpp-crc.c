@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <check.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "hidpp-crc.h"
+#include "libratbag-util.h"
+
+/* Known values for CRC-16/CCITT-FALSE */
+START_TEST(crc_ccitt_known)
+{
+	struct testcase {
+		const char *str;
+		uint16_t crc;
+	} tests[] = {
+		{ "", 0xffff },
+		{ "A", 0xb915 },
+		{ "123456789", 0x29b1 },
+	};
+	struct testcase *t;
+
+	ARRAY_FOR_EACH(tests, t) {
+		const uint8_t *data = (const uint8_t *)t->str;
+		unsigned int len = strlen(t->str);
+
+		ck_assert_int_eq(hidpp_crc_ccitt_bytewise(data, len), t->crc);
+		ck_assert_int_eq(hidpp_crc_ccitt_table(data, len), t->crc);
+		ck_assert_int_eq(hidpp_crc_ccitt_slice8(data, len), t->crc);
+		ck_assert_int_eq(hidpp_crc_ccitt(data, len), t->crc);
+	}
+}
+END_TEST
+
+/* All implementations must match the reference for any length and
+ * alignment */
+START_TEST(crc_ccitt_random)
+{
+	uint8_t buf[4096 + 8];
+	unsigned int i, offset, len;
+	uint16_t crc;
+
+	srand(0x1021);
+
+	for (i = 0; i < 2000; i++) {
+		for (len = 0; len < sizeof(buf); len++)
+			buf[len] = rand();
+
+		offset = rand() % 8;
+		len = i < 300 ? i : (unsigned int)rand() % (sizeof(buf) - offset);
+
+		crc = hidpp_crc_ccitt_bytewise(buf + offset, len);
+		ck_assert_int_eq(hidpp_crc_ccitt_table(buf + offset, len), crc);
+		ck_assert_int_eq(hidpp_crc_ccitt_slice8(buf + offset, len), crc);
+		ck_assert_int_eq(hidpp_crc_ccitt(buf + offset, len), crc);
+	}
+}
+END_TEST
+
+static Suite *
+test_hidpp_crc_suite(void)
+{
+	TCase *tc;
+	Suite *s;
+
+	s = suite_create("hidpp-crc");
+	tc = tcase_create("crc-ccitt");
+	tcase_add_test(tc, crc_ccitt_known);
+	tcase_add_test(tc, crc_ccitt_random);
+
+	suite_add_tcase(s, tc);
+	return s;
+}
+
+int main(void)
+{
+	int nfailed;
+	Suite *s;
+	SRunner *sr;
+	const struct rlimit corelimit = { 0, 0 };
+
+	setrlimit(RLIMIT_CORE, &corelimit);
+
+	s = test_hidpp_crc_suite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_ENV);
+	nfailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (nfailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,330 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <check.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "libratbag.h"
+#include "hidpp20-cache.h"
+#include "libratbag-util.h"
+
+#define FIRMWARE "U1 12.3.45"
+#define SECTOR_SIZE 16
+#define NUM_PROFILES 2
+
+static int
+open_restricted(const char *path, int flags, void *user_data)
+{
+	return -ENODEV;
+}
+
+static void
+close_restricted(int fd, void *user_data)
+{
+}
+
+static const struct ratbag_interface simple_iface = {
+	.open_restricted = open_restricted,
+	.close_restricted = close_restricted,
+};
+
+static const struct hidpp20_feature features[] = {
+	{ .feature = 0x0000, .type = 0x00, .version = 0 },
+	{ .feature = 0x0001, .type = 0x00, .version = 1 },
+	{ .feature = 0x8100, .type = 0x40, .version = 2 },
+};
+
+static struct ratbag *ratbag;
+static char tmpdir[] = "/tmp/ratbag-test-cache-XXXXXX";
+static char path[256];
+
+static void
+setup(void)
+{
+	ck_assert(mkdtemp(tmpdir) != NULL);
+	snprintf(path, sizeof(path), "%s/hidpp20/device.keyfile", tmpdir);
+
+	ratbag = ratbag_create_context(&simple_iface, NULL);
+	ck_assert(ratbag != NULL);
+}
+
+static void
+teardown(void)
+{
+	char dir[256];
+
+	ratbag_unref(ratbag);
+
+	unlink(path);
+	snprintf(dir, sizeof(dir), "%s/hidpp20", tmpdir);
+	rmdir(dir);
+	rmdir(tmpdir);
+	strcpy(tmpdir, "/tmp/ratbag-test-cache-XXXXXX");
+}
+
+static void
+write_file(const char *contents)
+{
+	char dir[256];
+	FILE *fp;
+
+	snprintf(dir, sizeof(dir), "%s/hidpp20", tmpdir);
+	mkdir(dir, 0755);
+
+	fp = fopen(path, "w");
+	ck_assert(fp != NULL);
+	fputs(contents, fp);
+	fclose(fp);
+}
+
+static void
+profiles_init(struct hidpp20_profiles *profiles, uint16_t sector_size)
+{
+	memset(profiles, 0, sizeof(*profiles));
+	profiles->sector_size = sector_size;
+	profiles->num_profiles = NUM_PROFILES;
+	profiles->shadow = calloc(NUM_PROFILES + 1, sector_size);
+	profiles->shadow_valid = calloc(NUM_PROFILES + 1, sizeof(bool));
+}
+
+static void
+profiles_fini(struct hidpp20_profiles *profiles)
+{
+	free(profiles->shadow);
+	free(profiles->shadow_valid);
+}
+
+START_TEST(cache_round_trip)
+{
+	struct hidpp20_profiles profiles, restored;
+	struct hidpp20_feature *list = NULL;
+	unsigned int count = 0;
+	GKeyFile *keyfile;
+	unsigned int i;
+	int rc;
+
+	profiles_init(&profiles, SECTOR_SIZE);
+	for (i = 0; i < SECTOR_SIZE; i++) {
+		profiles.shadow[i] = i;
+		profiles.shadow[2 * SECTOR_SIZE + i] = 0xff - i;
+	}
+	profiles.shadow_valid[0] = true;
+	profiles.shadow_valid[2] = true;
+
+	rc = hidpp20_cache_save(ratbag, path, FIRMWARE,
+				features, ARRAY_LENGTH(features), &profiles);
+	ck_assert_int_eq(rc, 0);
+
+	keyfile = hidpp20_cache_load(ratbag, path, FIRMWARE);
+	ck_assert(keyfile != NULL);
+
+	rc = hidpp20_cache_get_features(keyfile, &list, &count);
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_eq(count, ARRAY_LENGTH(features));
+	for (i = 0; i < count; i++) {
+		ck_assert_int_eq(list[i].feature, features[i].feature);
+		ck_assert_int_eq(list[i].type, features[i].type);
+		ck_assert_int_eq(list[i].version, features[i].version);
+	}
+
+	profiles_init(&restored, SECTOR_SIZE);
+	hidpp20_cache_get_sectors(keyfile, &restored);
+	ck_assert(restored.shadow_valid[0]);
+	ck_assert(!restored.shadow_valid[1]);
+	ck_assert(restored.shadow_valid[2]);
+	ck_assert_int_eq(memcmp(restored.shadow, profiles.shadow,
+				(NUM_PROFILES + 1) * SECTOR_SIZE), 0);
+
+	g_key_file_free(keyfile);
+	free(list);
+	profiles_fini(&profiles);
+	profiles_fini(&restored);
+}
+END_TEST
+
+START_TEST(cache_without_profiles)
+{
+	struct hidpp20_profiles restored;
+	GKeyFile *keyfile;
+	int rc;
+
+	rc = hidpp20_cache_save(ratbag, path, FIRMWARE,
+				features, ARRAY_LENGTH(features), NULL);
+	ck_assert_int_eq(rc, 0);
+
+	keyfile = hidpp20_cache_load(ratbag, path, FIRMWARE);
+	ck_assert(keyfile != NULL);
+
+	profiles_init(&restored, SECTOR_SIZE);
+	hidpp20_cache_get_sectors(keyfile, &restored);
+	ck_assert(!restored.shadow_valid[0]);
+	ck_assert(!restored.shadow_valid[1]);
+	ck_assert(!restored.shadow_valid[2]);
+
+	g_key_file_free(keyfile);
+	profiles_fini(&restored);
+}
+END_TEST
+
+START_TEST(cache_missing)
+{
+	ck_assert(hidpp20_cache_load(ratbag, path, FIRMWARE) == NULL);
+}
+END_TEST
+
+START_TEST(cache_firmware_mismatch)
+{
+	int rc;
+
+	rc = hidpp20_cache_save(ratbag, path, FIRMWARE,
+				features, ARRAY_LENGTH(features), NULL);
+	ck_assert_int_eq(rc, 0);
+
+	ck_assert(hidpp20_cache_load(ratbag, path, "U1 12.3.46") == NULL);
+}
+END_TEST
+
+START_TEST(cache_version_mismatch)
+{
+	write_file("[Cache]\n"
+		   "Version=1\n"
+		   "Firmware=" FIRMWARE "\n"
+		   "Features=0;1;33024;\n"
+		   "FeatureTypes=0;0;64;\n"
+		   "FeatureVersions=0;1;2;\n");
+
+	ck_assert(hidpp20_cache_load(ratbag, path, FIRMWARE) == NULL);
+}
+END_TEST
+
+START_TEST(cache_corrupt)
+{
+	write_file("\x01\x02garbage\n[Cache\nVersion\n");
+
+	ck_assert(hidpp20_cache_load(ratbag, path, FIRMWARE) == NULL);
+}
+END_TEST
+
+START_TEST(cache_inconsistent_features)
+{
+	struct hidpp20_feature *list = NULL;
+	unsigned int count = 0;
+	GKeyFile *keyfile;
+	int rc;
+
+	write_file("[Cache]\n"
+		   "Version=2\n"
+		   "Firmware=" FIRMWARE "\n"
+		   "Features=0;1;33024;\n"
+		   "FeatureTypes=0;0;\n"
+		   "FeatureVersions=0;1;2;\n");
+
+	keyfile = hidpp20_cache_load(ratbag, path, FIRMWARE);
+	ck_assert(keyfile != NULL);
+
+	rc = hidpp20_cache_get_features(keyfile, &list, &count);
+	ck_assert_int_eq(rc, -EINVAL);
+	ck_assert(list == NULL);
+
+	g_key_file_free(keyfile);
+}
+END_TEST
+
+START_TEST(cache_sector_size_mismatch)
+{
+	struct hidpp20_profiles profiles, restored;
+	GKeyFile *keyfile;
+	int rc;
+
+	profiles_init(&profiles, SECTOR_SIZE);
+	profiles.shadow_valid[0] = true;
+	profiles.shadow_valid[1] = true;
+
+	rc = hidpp20_cache_save(ratbag, path, FIRMWARE,
+				features, ARRAY_LENGTH(features), &profiles);
+	ck_assert_int_eq(rc, 0);
+
+	keyfile = hidpp20_cache_load(ratbag, path, FIRMWARE);
+	ck_assert(keyfile != NULL);
+
+	profiles_init(&restored, SECTOR_SIZE * 2);
+	hidpp20_cache_get_sectors(keyfile, &restored);
+	ck_assert(!restored.shadow_valid[0]);
+	ck_assert(!restored.shadow_valid[1]);
+
+	g_key_file_free(keyfile);
+	profiles_fini(&profiles);
+	profiles_fini(&restored);
+}
+END_TEST
+
+static Suite *
+test_hidpp20_cache_suite(void)
+{
+	TCase *tc;
+	Suite *s;
+
+	s = suite_create("hidpp20-cache");
+	tc = tcase_create("cache");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, cache_round_trip);
+	tcase_add_test(tc, cache_without_profiles);
+	tcase_add_test(tc, cache_missing);
+	tcase_add_test(tc, cache_firmware_mismatch);
+	tcase_add_test(tc, cache_version_mismatch);
+	tcase_add_test(tc, cache_corrupt);
+	tcase_add_test(tc, cache_inconsistent_features);
+	tcase_add_test(tc, cache_sector_size_mismatch);
+
+	suite_add_tcase(s, tc);
+	return s;
+}
+
+int main(void)
+{
+	int nfailed;
+	Suite *s;
+	SRunner *sr;
+	const struct rlimit corelimit = { 0, 0 };
+
+	setenv("RATBAG_TEST", "1", 0);
+
+	setrlimit(RLIMIT_CORE, &corelimit);
+
+	s = test_hidpp20_cache_suite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_ENV);
+	nfailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (nfailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <check.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "libratbag.h"
+#include "libratbag-hidraw.h"
+
+static int
+open_restricted(const char *path, int flags, void *user_data)
+{
+	return -ENODEV;
+}
+
+static void
+close_restricted(int fd, void *user_data)
+{
+}
+
+static const struct ratbag_interface simple_iface = {
+	.open_restricted = open_restricted,
+	.close_restricted = close_restricted,
+};
+
+static void
+parse(const uint8_t *desc, size_t len, struct ratbag_hidraw *hidraw, int expected)
+{
+	struct ratbag *r;
+	int rc;
+
+	r = ratbag_create_context(&simple_iface, NULL);
+	ck_assert(r != NULL);
+
+	rc = ratbag_hidraw_parse_report_descriptor_data(r, hidraw, desc, len);
+	ck_assert_int_eq(rc, expected);
+
+	ratbag_unref(r);
+}
+
+START_TEST(descriptor_unnumbered)
+{
+	const uint8_t desc[] = {
+		0x05, 0x01,		/* Usage Page (Generic Desktop) */
+		0x09, 0x02,		/* Usage (Mouse) */
+		0xa1, 0x01,		/* Collection (Application) */
+		0x75, 0x08,		/*  Report Size (8) */
+		0x95, 0x04,		/*  Report Count (4) */
+		0x81, 0x02,		/*  Input */
+		0x95, 0x02,		/*  Report Count (2) */
+		0xb1, 0x02,		/*  Feature */
+		0xc0,			/* End Collection */
+	};
+	struct ratbag_hidraw hidraw = {0};
+
+	parse(desc, sizeof(desc), &hidraw, 0);
+
+	ck_assert_int_eq(hidraw.num_reports, 0);
+	ck_assert_int_eq(hidraw.reports[0].report_id, 0);
+	ck_assert_int_eq(hidraw.reports[0].usage_page, 0x01);
+	ck_assert_int_eq(hidraw.reports[0].usage, 0x02);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_INPUT_REPORT], 32);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_OUTPUT_REPORT], 0);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_FEATURE_REPORT], 16);
+
+	free(hidraw.reports);
+}
+END_TEST
+
+START_TEST(descriptor_numbered)
+{
+	const uint8_t desc[] = {
+		0x06, 0x00, 0xff,	/* Usage Page (Vendor 0xff00) */
+		0x09, 0x01,		/* Usage (1) */
+		0xa1, 0x01,		/* Collection (Application) */
+		0x85, 0x10,		/*  Report ID (0x10) */
+		0x75, 0x08,		/*  Report Size (8) */
+		0x95, 0x06,		/*  Report Count (6) */
+		0x81, 0x00,		/*  Input */
+		0x91, 0x00,		/*  Output */
+		0x85, 0x11,		/*  Report ID (0x11) */
+		0x95, 0x13,		/*  Report Count (19) */
+		0x81, 0x00,		/*  Input */
+		0x85, 0x10,		/*  Report ID (0x10) */
+		0x95, 0x01,		/*  Report Count (1) */
+		0xb1, 0x00,		/*  Feature */
+		0xc0,			/* End Collection */
+	};
+	struct ratbag_hidraw hidraw = {0};
+
+	parse(desc, sizeof(desc), &hidraw, 0);
+
+	ck_assert_int_eq(hidraw.num_reports, 2);
+	ck_assert_int_eq(hidraw.reports[0].report_id, 0x10);
+	ck_assert_int_eq(hidraw.reports[0].usage_page, 0xff00);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_INPUT_REPORT], 48);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_OUTPUT_REPORT], 48);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_FEATURE_REPORT], 8);
+	ck_assert_int_eq(hidraw.reports[1].report_id, 0x11);
+	ck_assert_int_eq(hidraw.reports[1].size_bits[HID_INPUT_REPORT], 152);
+
+	free(hidraw.reports);
+}
+END_TEST
+
+/* main items before the first report ID don't belong to that report */
+START_TEST(descriptor_items_before_report_id)
+{
+	const uint8_t desc[] = {
+		0x06, 0x00, 0xff,	/* Usage Page (Vendor 0xff00) */
+		0x09, 0x01,		/* Usage (1) */
+		0xa1, 0x01,		/* Collection (Application) */
+		0x75, 0x08,		/*  Report Size (8) */
+		0x95, 0x04,		/*  Report Count (4) */
+		0x81, 0x00,		/*  Input */
+		0x85, 0x01,		/*  Report ID (1) */
+		0x95, 0x02,		/*  Report Count (2) */
+		0x81, 0x00,		/*  Input */
+		0xc0,			/* End Collection */
+	};
+	struct ratbag_hidraw hidraw = {0};
+
+	parse(desc, sizeof(desc), &hidraw, 0);
+
+	ck_assert_int_eq(hidraw.num_reports, 1);
+	ck_assert_int_eq(hidraw.reports[0].report_id, 1);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_INPUT_REPORT], 16);
+
+	free(hidraw.reports);
+}
+END_TEST
+
+START_TEST(descriptor_push_pop)
+{
+	const uint8_t desc[] = {
+		0x06, 0x00, 0xff,	/* Usage Page (Vendor 0xff00) */
+		0x09, 0x01,		/* Usage (1) */
+		0xa1, 0x01,		/* Collection (Application) */
+		0x75, 0x08,		/*  Report Size (8) */
+		0x95, 0x01,		/*  Report Count (1) */
+		0xa4,			/*  Push (no report ID) */
+		0x85, 0x01,		/*  Report ID (1) */
+		0x81, 0x00,		/*  Input */
+		0xa4,			/*  Push (report ID 1) */
+		0x85, 0x02,		/*  Report ID (2) */
+		0x95, 0x03,		/*  Report Count (3) */
+		0x81, 0x00,		/*  Input */
+		0xb4,			/*  Pop (report ID 1, count 1) */
+		0x81, 0x00,		/*  Input */
+		0xb4,			/*  Pop (no report ID) */
+		0x95, 0x10,		/*  Report Count (16) */
+		0x81, 0x00,		/*  Input */
+		0xc0,			/* End Collection */
+	};
+	struct ratbag_hidraw hidraw = {0};
+
+	parse(desc, sizeof(desc), &hidraw, 0);
+
+	ck_assert_int_eq(hidraw.num_reports, 2);
+	ck_assert_int_eq(hidraw.reports[0].report_id, 1);
+	ck_assert_int_eq(hidraw.reports[0].size_bits[HID_INPUT_REPORT], 16);
+	ck_assert_int_eq(hidraw.reports[1].report_id, 2);
+	ck_assert_int_eq(hidraw.reports[1].size_bits[HID_INPUT_REPORT], 24);
+
+	free(hidraw.reports);
+}
+END_TEST
+
+START_TEST(descriptor_malformed)
+{
+	const uint8_t truncated[] = {
+		0x06, 0x00,		/* Usage Page, missing a byte */
+	};
+	const uint8_t pop_without_push[] = {
+		0xb4,			/* Pop */
+		0xc0,
+	};
+	struct ratbag_hidraw hidraw = {0};
+
+	parse(truncated, sizeof(truncated), &hidraw, -EPROTO);
+	ck_assert(hidraw.reports == NULL);
+	ck_assert_int_eq(hidraw.num_reports, 0);
+
+	parse(pop_without_push, sizeof(pop_without_push), &hidraw, -EPROTO);
+	ck_assert(hidraw.reports == NULL);
+}
+END_TEST
+
+static Suite *
+test_hidraw_suite(void)
+{
+	TCase *tc;
+	Suite *s;
+
+	s = suite_create("hidraw");
+	tc = tcase_create("descriptor");
+	tcase_add_test(tc, descriptor_unnumbered);
+	tcase_add_test(tc, descriptor_numbered);
+	tcase_add_test(tc, descriptor_items_before_report_id);
+	tcase_add_test(tc, descriptor_push_pop);
+	tcase_add_test(tc, descriptor_malformed);
+
+	suite_add_tcase(s, tc);
+	return s;
+}
+
+int main(void)
+{
+	int nfailed;
+	Suite *s;
+	SRunner *sr;
+	const struct rlimit corelimit = { 0, 0 };
+
+	setenv("RATBAG_TEST", "1", 0);
+
+	setrlimit(RLIMIT_CORE, &corelimit);
+
+	s = test_hidraw_suite();
+	sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_ENV);
+	nfailed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (nfailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -25,11 +25,13 @@
 
 #include <check.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <errno.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/resource.h>
 
@@ -122,6 +124,118 @@ START_TEST(dpi_list_parser)
 }
 END_TEST
 
+struct poll_data {
+	unsigned int calls;
+	unsigned int busy_calls;	/* -EAGAIN for this many calls */
+	int rc;				/* then this */
+};
+
+static int
+poll_is_ready(void *data)
+{
+	struct poll_data *d = data;
+
+	if (d->calls++ < d->busy_calls)
+		return -EAGAIN;
+
+	return d->rc;
+}
+
+static uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+START_TEST(poll_ready_immediately)
+{
+	struct ratbag_poll_latency latency = {0};
+	struct poll_data d = { .busy_calls = 0, .rc = 0 };
+	int rc;
+
+	rc = ratbag_poll_ready(&latency, 0, 1000, poll_is_ready, &d);
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_eq(d.calls, 1);
+
+	/* a positive value counts as ready too */
+	d.calls = 0;
+	d.rc = 3;
+	rc = ratbag_poll_ready(NULL, 0, 1000, poll_is_ready, &d);
+	ck_assert_int_eq(rc, 3);
+	ck_assert_int_eq(d.calls, 1);
+}
+END_TEST
+
+START_TEST(poll_ready_timeout)
+{
+	struct ratbag_poll_latency latency = { .ms = 5 };
+	struct poll_data d = { .busy_calls = UINT_MAX };
+	uint64_t start, elapsed;
+	int rc;
+
+	start = now_ms();
+	rc = ratbag_poll_ready(&latency, 0, 50, poll_is_ready, &d);
+	elapsed = now_ms() - start;
+
+	ck_assert_int_eq(rc, -ETIMEDOUT);
+	ck_assert_int_gt(d.calls, 1);
+	ck_assert_int_ge(elapsed, 50);
+	/* generous, it only has to stop eventually */
+	ck_assert_int_lt(elapsed, 5000);
+	/* a timeout doesn't count towards the latency */
+	ck_assert_int_eq(latency.ms, 5);
+}
+END_TEST
+
+START_TEST(poll_ready_error)
+{
+	struct ratbag_poll_latency latency = { .ms = 5 };
+	struct poll_data d = { .busy_calls = 2, .rc = -EIO };
+	int rc;
+
+	rc = ratbag_poll_ready(&latency, 0, 1000, poll_is_ready, &d);
+	ck_assert_int_eq(rc, -EIO);
+	ck_assert_int_eq(d.calls, 3);
+	/* neither does an error */
+	ck_assert_int_eq(latency.ms, 5);
+}
+END_TEST
+
+START_TEST(poll_ready_latency)
+{
+	struct ratbag_poll_latency latency = {0};
+	struct poll_data d = { .busy_calls = 0, .rc = 0 };
+	uint64_t start, elapsed;
+	int rc;
+
+	/* the first wait sets the latency */
+	rc = ratbag_poll_ready(&latency, 20, 1000, poll_is_ready, &d);
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_ge(latency.ms, 20);
+
+	/* later ones move it a quarter of the way */
+	latency.ms = 100;
+	d.calls = 0;
+	rc = ratbag_poll_ready(&latency, 20, 1000, poll_is_ready, &d);
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_ge(latency.ms, 80);
+
+	/* the first retry waits for the rest of the latency */
+	latency.ms = 60;
+	d.calls = 0;
+	d.busy_calls = 1;
+	start = now_ms();
+	rc = ratbag_poll_ready(&latency, 0, 1000, poll_is_ready, &d);
+	elapsed = now_ms() - start;
+	ck_assert_int_eq(rc, 0);
+	ck_assert_int_eq(d.calls, 2);
+	ck_assert_int_ge(elapsed, 60);
+}
+END_TEST
+
 static Suite *
 test_context_suite(void)
 {
@@ -132,6 +246,10 @@ test_context_suite(void)
 	tc = tcase_create("util");
 	tcase_add_test(tc, dpi_range_parser);
 	tcase_add_test(tc, dpi_list_parser);
+	tcase_add_test(tc, poll_ready_immediately);
+	tcase_add_test(tc, poll_ready_timeout);
+	tcase_add_test(tc, poll_ready_error);
+	tcase_add_test(tc, poll_ready_latency);
 
 	suite_add_tcase(s, tc);
 	return s;